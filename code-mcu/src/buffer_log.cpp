@@ -1,36 +1,61 @@
 #include "buffer_log.h"
 
-#include <stdlib.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
 #include <string.h>
 
-static int cmp_uint16(const void *a, const void *b)
-{
-    uint16_t ua = *(const uint16_t *)a;
-    uint16_t ub = *(const uint16_t *)b;
-    return (ua > ub) - (ua < ub);
-}
-
 uint16_t BufferLog::getAvg() volatile const
 {
+    // Interrupts are only off while the ISR's buffer is copied
+    uint16_t vals[bufSz];
+    uint8_t count;
+    uint8_t sreg = SREG;
+    cli();
+    count = ix;
+    if (full) count = bufSz;
+    memcpy(vals, (const void *)buf, sizeof(uint16_t) * count);
+    SREG = sreg;
+
     uint32_t sum = 0;
-    if (!full)
+    if (count < bufSz)
     {
-        for (uint8_t i = 0; i < ix; ++i)
-            sum += buf[i];
-        return (sum + ix / 2) / ix;
+        if (count == 0) return 0;
+        for (uint8_t i = 0; i < count; ++i)
+            sum += vals[i];
+        return (sum + count / 2) / count;
     }
 
-    // Discard outliers: 10 on both sides
-    const uint8_t discardBand = 10;
-    memcpy((void *)buf2, (void *)buf, sizeof(uint16_t) * bufSz);
-    qsort((void *)buf2, bufSz, sizeof(uint16_t), cmp_uint16);
-    uint8_t sz = bufSz - 2 * discardBand;
-    uint16_t max = 0;
-    for (uint8_t i = discardBand; i < bufSz - discardBand; ++i)
+    // Partial selection: keep only the discard bands sorted, i.e., the
+    // smallest and largest few values, instead of sorting the whole buffer
+    uint16_t lo[discardBand];
+    uint16_t hi[discardBand];
+    uint8_t nLo = 0, nHi = 0;
+    for (uint8_t i = 0; i < bufSz; ++i)
     {
-        sum += buf[i];
-        if (buf[i] > max) max = buf[i];
+        uint16_t v = vals[i];
+        sum += v;
+
+        // lo is ascending; drop its largest when full
+        if (nLo < discardBand || v < lo[nLo - 1])
+        {
+            int8_t j = nLo < discardBand ? nLo++ : nLo - 1;
+            for (; j > 0 && lo[j - 1] > v; --j)
+                lo[j] = lo[j - 1];
+            lo[j] = v;
+        }
+
+        // hi is descending; drop its smallest when full
+        if (nHi < discardBand || v > hi[nHi - 1])
+        {
+            int8_t j = nHi < discardBand ? nHi++ : nHi - 1;
+            for (; j > 0 && hi[j - 1] < v; --j)
+                hi[j] = hi[j - 1];
+            hi[j] = v;
+        }
     }
-    // return max;
+    for (uint8_t i = 0; i < discardBand; ++i)
+        sum -= (uint32_t)lo[i] + hi[i];
+
+    const uint8_t sz = bufSz - 2 * discardBand;
     return (sum + sz / 2) / sz;
 }
@@ -6,8 +6,9 @@
 struct BufferLog
 {
     static const uint8_t bufSz = 50;
+    // Trimmed mean discards this many values on both sides
+    static const uint8_t discardBand = 10;
     volatile uint16_t buf[bufSz] = {0};
-    volatile mutable uint16_t buf2[bufSz] = {0};
     volatile bool full = false;
     volatile uint8_t ix = 0;
 
@@ -18,7 +19,7 @@ struct BufferLog
         if (ix == 0) full = true;
     }
 
-    uint16_t BufferLog::getAvg() volatile const;
+    uint16_t getAvg() volatile const;
 };
 
 #endif
@@ -0,0 +1,62 @@
+#include "envelope.h"
+
+void Envelope::start(uint8_t peak, uint16_t attack, uint16_t sustain, uint16_t decay, uint32_t now)
+{
+    this->peak = peak;
+    this->attack = attack;
+    this->sustain = sustain;
+    this->decay = decay;
+    startTime = now;
+    active = true;
+}
+
+uint8_t Envelope::valueAt(uint32_t now)
+{
+    if (!active) return 0;
+
+    uint32_t t = now - startTime;
+    if (t < attack) return (uint32_t)peak * t / attack;
+    t -= attack;
+    if (t < sustain) return peak;
+    t -= sustain;
+    if (t < decay) return peak - (uint32_t)peak * t / decay;
+
+    active = false;
+    return 0;
+}
+
+void Fade::start(uint8_t from, uint8_t to, uint16_t duration, uint32_t now)
+{
+    this->from = from;
+    this->to = to;
+    this->duration = duration;
+    startTime = now;
+    breathing = false;
+}
+
+void Fade::breathe(uint8_t low, uint8_t high, uint16_t period, uint32_t now)
+{
+    from = low;
+    to = high;
+    duration = period < 2 ? 2 : period;
+    startTime = now;
+    breathing = true;
+}
+
+uint8_t Fade::valueAt(uint32_t now) const
+{
+    uint32_t t = now - startTime;
+    uint16_t span = duration;
+    if (breathing)
+    {
+        // Triangle wave: up in first half of the period, down in the second
+        span = duration / 2;
+        t %= duration;
+        if (t >= span) t = duration - t;
+        if (t > span) t = span;
+    }
+    else if (t >= span)
+        return to;
+
+    return from + ((int32_t)to - from) * (int32_t)t / span;
+}
@@ -0,0 +1,36 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stdint.h>
+
+// Attack-sustain-decay envelope: ramps up to peak, holds, ramps back down to 0.
+// Times are in milliseconds; levels are PWM duty values.
+struct Envelope
+{
+    uint8_t peak = 0;
+    uint16_t attack = 0;
+    uint16_t sustain = 0;
+    uint16_t decay = 0;
+    uint32_t startTime = 0;
+    bool active = false;
+
+    void start(uint8_t peak, uint16_t attack, uint16_t sustain, uint16_t decay, uint32_t now);
+    uint8_t valueAt(uint32_t now);
+};
+
+// Linear fade between two levels, then holds the target. In breathing mode it swings
+// back and forth between the two levels forever instead; duration is then the period.
+struct Fade
+{
+    uint8_t from = 0;
+    uint8_t to = 0;
+    uint16_t duration = 0;
+    uint32_t startTime = 0;
+    bool breathing = false;
+
+    void start(uint8_t from, uint8_t to, uint16_t duration, uint32_t now);
+    void breathe(uint8_t low, uint8_t high, uint16_t period, uint32_t now);
+    uint8_t valueAt(uint32_t now) const;
+};
+
+#endif
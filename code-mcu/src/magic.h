@@ -11,9 +11,32 @@
 #define KNOB_B_PIN          PIN_PA2
 #define KNOB_C_PIN          PIN_PA3
 #define TUNER_PIN           PIN_PA4
+#define ATTN_PIN            PIN_PA6
+
+// ADC0 inputs of the analog pins above
+#define KNOB_A_AIN          ADC_MUXPOS_AIN1_gc
+#define KNOB_B_AIN          ADC_MUXPOS_AIN2_gc
+#define KNOB_C_AIN          ADC_MUXPOS_AIN3_gc
+#define TUNER_AIN           ADC_MUXPOS_AIN4_gc
+
+// Tuner oversampling: hardware accumulates 4^n samples for n extra bits
+#define TUNER_SAMPNUM       ADC_SAMPNUM_ACC16_gc
+#define TUNER_EXTRA_BITS    2
+
+// Switch discharge is timed in CLK_PER ticks; a step of the old polling loop took about this long
+#define SWITCH_TICKS_PER_STEP   30
+#define SWITCH_TIMEOUT_TICKS    (10000000UL / MEASURE_FREQ)
+
+// In attention mode, ATTN_PIN is pulled low once an input moved this far since the Pi's last read
+#define ATTN_THRESHOLD          4
+#define ATTN_SWITCH_THRESHOLD   100
 
 #define SLAVE_ADDRESS       0x50
 
-#define MEASURE_FREQ        500
+#define MEASURE_FREQ        2000
+
+// Burst reply carries the analog channels decimated to MEASURE_FREQ / BURST_DECIMATION,
+// newest BURST_LENGTH samples each; span must exceed the Pi's polling period
+#define BURST_DECIMATION    20
 
 #endif
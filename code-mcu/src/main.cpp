@@ -2,35 +2,70 @@
 #include <Wire.h>
 
 #include "buffer_log.h"
+#include "envelope.h"
 #include "magic.h"
+#include "protocol.h"
 
-#pragma pack(push, 1)
-struct InputReadings
-{
-    uint16_t tuner;
-    uint16_t aKnob;
-    uint16_t bKnob;
-    uint16_t cKnob;
-    uint8_t swtch;
-};
-#pragma pack(pop)
-
-static const int recvBufSz = 8;
-static const int sendBufSz = 10;
+static const int recvBufSz = 2 * MAX_COMMAND_SIZE;
+// Writes arrive through the same TWI buffer as replies leave
+static const uint8_t wireBufSz = MAX_REPLY_SIZE;
 
 static volatile uint8_t recvBuf[recvBufSz];
 static volatile int recvBufPtr = 0;
-static volatile uint8_t sendBuf[sendBufSz];
-static volatile int sendBytes = 0;
+// Main loop fills the back snapshot, then flips frontIx; onWireRequest only copies the front one
+static volatile Frame<InputReadingsEx> snapshots[2];
+static volatile uint8_t frontIx = 0;
+static volatile uint8_t replyCmd = CMD_READINGS;
+static volatile uint32_t sampleTicks = 0;
+static uint32_t refreshedTicks = 0;
+static uint16_t snapshotSeq = 0;
 static volatile BufferLog aKnobLog;
 static volatile BufferLog bKnobLog;
 static volatile BufferLog cKnobLog;
 static volatile BufferLog tunerLog;
-static volatile uint8_t swtch;
+static volatile BufferLog swtchLog;
+// Set when switch pin is released; cleared by the capture of its falling edge
+static volatile bool swtchPending = false;
+
+// Channels converted one after the other after each timer tick
+static const uint8_t adcChannelCount = 4;
+static const uint8_t adcChannels[adcChannelCount] = {KNOB_A_AIN, KNOB_B_AIN, KNOB_C_AIN, TUNER_AIN};
+static volatile BufferLog *const adcLogs[adcChannelCount] = {&aKnobLog, &bKnobLog, &cKnobLog, &tunerLog};
+// Tuner is accumulated in hardware: 4^n samples per conversion, decimated to n extra bits
+static const uint8_t adcSampNums[adcChannelCount] = {ADC_SAMPNUM_ACC1_gc, ADC_SAMPNUM_ACC1_gc, ADC_SAMPNUM_ACC1_gc, TUNER_SAMPNUM};
+static const uint8_t adcShifts[adcChannelCount] = {0, 0, 0, TUNER_EXTRA_BITS};
+static volatile uint8_t adcChannel = adcChannelCount;
+
+// Sums of each channel over current decimation period, and ring of completed sums;
+// main loop divides them, to keep the division out of the ISR
+static volatile uint32_t decimSums[adcChannelCount];
+static volatile uint8_t decimCount = 0;
+static volatile uint32_t burstRing[adcChannelCount][BURST_LENGTH];
+static volatile uint8_t burstPos = 0;
+static volatile uint16_t burstSeq = 0;
+static uint16_t encodedBurstSeq = 0;
+// Double-buffered like the snapshots
+static volatile Frame<BurstReadings> bursts[2];
+static Frame<HelloReply> hello;
+static volatile uint8_t burstFrontIx = 0;
+
+// Attention mode: inputs as of the Pi's last read; onWireRequest flags which snapshot it sent
+static bool attnEnabled = false;
+static InputReadingsEx attnRef;
+static volatile bool attnAcked = false;
+static volatile uint8_t attnAckedIx = 0;
+
+// Vibration motor's PWM duty follows this
+static Envelope haptic;
+// Light's perceptual level follows this
+static Fade lightFade;
 
 static void onWireReceive(int bytecount);
 static void onWireRequest();
-static void handleCommand(uint8_t b);
+static void handleCommand(const uint8_t *buf);
+static void refreshReadings(uint32_t ticks);
+static void refreshBurst();
+static void updateAttention();
 
 void setup()
 {
@@ -38,29 +73,71 @@ void setup()
     pinMode(ONBOARD_LED_PIN, OUTPUT);
     digitalWrite(ONBOARD_LED_PIN, HIGH);
 
-    // Device inputs
-    analogReference(VDD);
-    pinMode(KNOB_A_PIN, INPUT);
-    pinMode(KNOB_B_PIN, INPUT);
-    pinMode(KNOB_C_PIN, INPUT);
-    pinMode(TUNER_PIN, INPUT);
+    // Device inputs; analog pins have their digital input buffer disabled
     pinMode(KNOB_SWITCH_PIN, INPUT);
+    PORTA.PIN1CTRL = PORT_ISC_INPUT_DISABLE_gc;
+    PORTA.PIN2CTRL = PORT_ISC_INPUT_DISABLE_gc;
+    PORTA.PIN3CTRL = PORT_ISC_INPUT_DISABLE_gc;
+    PORTA.PIN4CTRL = PORT_ISC_INPUT_DISABLE_gc;
 
     // Device outputs
+    // Light: PA7 has no timer output, so TCA0 WO1 (low byte's compare 1 in the core's split mode)
+    // reaches it through CCL LUT1, whose output is on PA7. LUT output is simply its input 1.
+    // WO1's own pin output stays disabled: that's PB1, the I2C data line.
     pinMode(LIGHT_CTRL_PIN, OUTPUT);
-    // digitalWrite(LIGHT_CTRL_PIN, HIGH);
+    TCA0.SPLIT.LCMP1 = 0;
+    CCL.LUT1CTRLB = CCL_INSEL1_TCA0_gc;
+    CCL.LUT1CTRLC = 0;
+    CCL.TRUTH1 = 0xCC;
+    CCL.LUT1CTRLA = CCL_OUTEN_bm | CCL_ENABLE_bm;
+    CCL.CTRLA = CCL_ENABLE_bm;
+    // Attention line is active low
+    digitalWrite(ATTN_PIN, HIGH);
+    pinMode(ATTN_PIN, OUTPUT);
+    // Vibration motor: PWM from TCA0 WO3, moved from PA3 to PC3. Core already runs TCA0 in
+    // split mode for analogWrite(), with HPER = 254 at ~1 kHz; WO3 is high byte's compare 0.
+    pinMode(VIBE_CTRL_PIN, OUTPUT);
+    PORTMUX.CTRLC |= PORTMUX_TCA03_bm;
+    TCA0.SPLIT.HCMP0 = 0;
+    TCA0.SPLIT.CTRLB |= TCA_SPLIT_HCMP0EN_bm;
+
+    // Switch pin's edges go to TCB1 (async user 11) through async event channel 2 (PORTC);
+    // all async users share the value enum of user 0
+    EVSYS.ASYNCCH2 = EVSYS_ASYNCCH2_PORTC_PIN2_gc;
+    EVSYS.ASYNCUSER11 = EVSYS_ASYNCUSER0_ASYNCCH2_gc;
 
     // CPU clock 10MHz: prescaler enabled, DIV2
     CCP = CCP_IOREG_gc;
     CLKCTRL.MCLKCTRLB = CLKCTRL_PDIV_2X_gc | CLKCTRL_PEN_bm;
 
-    // Timer B, 250 times per second
+    // ADC0: 10 bits, VDD reference, CLK_PER/8 = 1.25 MHz; interrupt on each result
+    // Accumulated tuner conversion takes ~200us, whole sequence fits in one timer period
+    ADC0.CTRLA = ADC_RESSEL_10BIT_gc;
+    ADC0.CTRLC = ADC_SAMPCAP_bm | ADC_REFSEL_VDDREF_gc | ADC_PRESC_DIV8_gc;
+    ADC0.CTRLD = ADC_INITDLY_DLY16_gc;
+    ADC0.INTCTRL = ADC_RESRDY_bm;
+    ADC0.CTRLA |= ADC_ENABLE_bm;
+
+    // Timer B, MEASURE_FREQ times per second
     TCB0.CTRLA = 0;
     TCB0.CTRLB = TCB_CNTMODE_INT_gc;
     TCB0.CCMP = (10000000UL / MEASURE_FREQ) - 1;
     TCB0.INTCTRL = TCB_CAPT_bm;
     TCB0.CTRLA = TCB_ENABLE_bm;
 
+    // Timer B1, free-running at CLK_PER; captures count on falling edge of switch pin
+    TCB1.CTRLA = 0;
+    TCB1.CTRLB = TCB_CNTMODE_CAPT_gc;
+    TCB1.EVCTRL = TCB_CAPTEI_bm | TCB_EDGE_bm;
+    TCB1.INTCTRL = TCB_CAPT_bm;
+    TCB1.CTRLA = TCB_ENABLE_bm;
+
+    // Constant reply to CMD_HELLO
+    hello.payload.capabilities = CAP_READINGS_EX | CAP_BURST | CAP_ATTENTION | CAP_HAPTIC | CAP_LIGHT_FADE;
+    hello.payload.samplePeriod = 1000000UL / MEASURE_FREQ;
+    hello.payload.burstPeriod = BURST_DECIMATION * (1000000UL / MEASURE_FREQ);
+    sealFrame(hello);
+
     // I2C slave
     Wire.begin(SLAVE_ADDRESS);
     Wire.onReceive(onWireReceive);
@@ -71,34 +148,107 @@ ISR(TCB0_INT_vect)
 {
     TCB0.INTFLAGS = TCB_CAPT_bm;
 
-    aKnobLog.logValue(analogRead(KNOB_A_PIN));
-    bKnobLog.logValue(analogRead(KNOB_B_PIN));
-    cKnobLog.logValue(analogRead(KNOB_C_PIN));
-    tunerLog.logValue(analogRead(TUNER_PIN));
+    // Kick off conversion of first channel; ADC interrupt sequences the rest.
+    // If the previous sequence is somehow still running, skip this tick.
+    if (adcChannel == adcChannelCount)
+    {
+        adcChannel = 0;
+        ADC0.CTRLB = adcSampNums[0];
+        ADC0.MUXPOS = adcChannels[0];
+        ADC0.COMMAND = ADC_STCONV_bm;
+    }
+
+    // No falling edge during the whole period: discharge slower than we can measure
+    if (swtchPending) swtchLog.logValue(SWITCH_TIMEOUT_TICKS);
 
+    // Charge switch, then release it and time the discharge from zero. Capture is armed before
+    // the release: a fast discharge can fall right away, and that edge must not be cleared.
     pinMode(KNOB_SWITCH_PIN, OUTPUT);
     digitalWrite(KNOB_SWITCH_PIN, HIGH);
+    TCB1.CNT = 0;
+    TCB1.INTFLAGS = TCB_CAPT_bm;
+    swtchPending = true;
     pinMode(KNOB_SWITCH_PIN, INPUT);
-    for (swtch = 0; swtch < 16; ++swtch)
+}
+
+ISR(TCB1_INT_vect)
+{
+    // Reading the captured count clears the interrupt flag
+    uint16_t ticks = TCB1.CCMP;
+    if (!swtchPending) return;
+    swtchPending = false;
+    swtchLog.logValue(ticks);
+}
+
+ISR(ADC0_RESRDY_vect)
+{
+    // Reading the result clears the interrupt flag. Accumulated sum of 4^n samples
+    // has 2n extra bits; shifting out n of them leaves n bits of extra resolution.
+    uint16_t res = ADC0.RES >> adcShifts[adcChannel];
+    adcLogs[adcChannel]->logValue(res);
+    decimSums[adcChannel] += res;
+
+    if (++adcChannel < adcChannelCount)
     {
-        if (digitalRead(KNOB_SWITCH_PIN) == LOW) break;
+        ADC0.CTRLB = adcSampNums[adcChannel];
+        ADC0.MUXPOS = adcChannels[adcChannel];
+        ADC0.COMMAND = ADC_STCONV_bm;
+    }
+    else
+    {
+        // Whole sequence done: main loop can refresh its snapshot
+        ++sampleTicks;
+
+        if (++decimCount == BURST_DECIMATION)
+        {
+            uint8_t pos = (burstPos + 1) % BURST_LENGTH;
+            for (uint8_t ch = 0; ch < adcChannelCount; ++ch)
+            {
+                burstRing[ch][pos] = decimSums[ch];
+                decimSums[ch] = 0;
+            }
+            burstPos = pos;
+            ++burstSeq;
+            decimCount = 0;
+        }
     }
 }
 
 static void onWireReceive(int byteCount)
 {
-    while (byteCount > 0)
+    // Whole write first: only bytes where a command starts may select a reply, not its arguments
+    uint8_t in[wireBufSz];
+    uint8_t len = 0;
+    while (true)
     {
         int dd = Wire.read();
         if (dd == -1) break;
-        if (recvBufPtr == recvBufSz) continue;
-        recvBuf[recvBufPtr++] = (uint8_t)dd;
+        if (len < wireBufSz) in[len++] = (uint8_t)dd;
     }
+
+    // Commands are queued whole or not at all, so the main loop never sees half of one.
+    // Reply selection takes effect immediately, for the read that follows.
+    uint8_t reply = replyCmd;
+    recvBufPtr += splitWrite(in, len, (uint8_t *)recvBuf + recvBufPtr, recvBufSz - recvBufPtr, reply);
+    replyCmd = reply;
 }
 
 static void onWireRequest()
 {
-    Wire.write((const uint8_t *)sendBuf, sendBytes);
+    // Any read counts as the Pi catching up with the inputs
+    digitalWriteFast(ATTN_PIN, HIGH);
+    attnAckedIx = frontIx;
+    attnAcked = true;
+
+    // Unknown selection gets the legacy reply, which the Pi will reject as a frame
+    if (replyCmd == CMD_READINGS_EX)
+        Wire.write((const uint8_t *)&snapshots[frontIx], sizeof(Frame<InputReadingsEx>));
+    else if (replyCmd == CMD_BURST)
+        Wire.write((const uint8_t *)&bursts[burstFrontIx], sizeof(Frame<BurstReadings>));
+    else if (replyCmd == CMD_HELLO)
+        Wire.write((const uint8_t *)&hello, sizeof(Frame<HelloReply>));
+    else
+        Wire.write((const uint8_t *)&snapshots[frontIx].payload.readings, sizeof(InputReadings));
 }
 
 void loop()
@@ -111,34 +261,167 @@ void loop()
     recvBufPtr = 0;
     sei();
 
-    for (int i = 0; i < nBytes; ++i)
+    for (int i = 0; i < nBytes;)
+    {
+        uint8_t len = commandLength(buf[i]);
+        if (i + len > nBytes) break;
+        handleCommand(buf + i);
+        i += len;
+    }
+
+    uint32_t now = millis();
+    TCA0.SPLIT.HCMP0 = haptic.valueAt(now);
+    // Squaring is close enough to gamma 2.2 for a lamp, and cheap
+    uint16_t light = lightFade.valueAt(now);
+    TCA0.SPLIT.LCMP1 = (light * light + 127) / 255;
+
+    // Before the refresh below, which may overwrite the snapshot the Pi read last
+    updateAttention();
+
+    // Recompute snapshot whenever the ISR has logged new samples
+    uint32_t ticks;
+    cli();
+    ticks = sampleTicks;
+    sei();
+    if (ticks != refreshedTicks)
     {
-        handleCommand(buf[i]);
+        refreshedTicks = ticks;
+        refreshReadings(ticks);
     }
+
+    // Re-encode burst whenever a new decimated sample is in the ring
+    uint16_t seq;
+    cli();
+    seq = burstSeq;
+    sei();
+    if (seq != encodedBurstSeq)
+    {
+        encodedBurstSeq = seq;
+        refreshBurst();
+    }
+}
+
+static void refreshReadings(uint32_t ticks)
+{
+    Frame<InputReadingsEx> frame;
+    InputReadingsEx &snapshot = frame.payload;
+    uint16_t tunerFine = tunerLog.getAvg();
+    snapshot.readings.tuner = tunerFine >> TUNER_EXTRA_BITS;
+    snapshot.readings.aKnob = aKnobLog.getAvg();
+    snapshot.readings.bKnob = bKnobLog.getAvg();
+    snapshot.readings.cKnob = cKnobLog.getAvg();
+    uint16_t swtchTicks = swtchLog.getAvg();
+    // Legacy field keeps the scale of the old 16-step polling loop
+    uint16_t swtch = swtchTicks / SWITCH_TICKS_PER_STEP;
+    snapshot.readings.swtch = swtch > 16 ? 16 : swtch;
+    snapshot.seq = ++snapshotSeq;
+    snapshot.sampleTime = ticks * (1000000UL / MEASURE_FREQ);
+    snapshot.tunerFine = tunerFine;
+    snapshot.swtchTicks = swtchTicks;
+    sealFrame(frame);
+
+    uint8_t backIx = frontIx ^ 1;
+    memcpy((void *)&snapshots[backIx], &frame, sizeof(frame));
+    // Single-byte store is atomic, so the TWI interrupt sees either buffer whole
+    frontIx = backIx;
 }
 
-void handleCommand(uint8_t cmd)
+static void refreshBurst()
 {
-    if (cmd == 0x00)
+    // Ring, its position and counter must be copied in one go
+    uint32_t ring[adcChannelCount][BURST_LENGTH];
+    uint8_t newestPos;
+    uint16_t seq;
+    cli();
+    memcpy(ring, (const void *)burstRing, sizeof(ring));
+    newestPos = burstPos;
+    seq = burstSeq;
+    sei();
+
+    Frame<BurstReadings> frame;
+    BurstReadings &burst = frame.payload;
+    burst.seq = seq;
+    for (uint8_t ch = 0; ch < adcChannelCount; ++ch)
+    {
+        // Oldest sample sits right after the newest one in the ring
+        uint8_t pos = (newestPos + 1) % BURST_LENGTH;
+        int16_t decoded = (ring[ch][pos] + BURST_DECIMATION / 2) / BURST_DECIMATION;
+        burst.channels[ch].first = decoded;
+        for (uint8_t i = 0; i < BURST_LENGTH - 1; ++i)
+        {
+            pos = (pos + 1) % BURST_LENGTH;
+            int16_t val = (ring[ch][pos] + BURST_DECIMATION / 2) / BURST_DECIMATION;
+            // Delta against what the reader will decode, so saturation error doesn't accumulate
+            int16_t delta = val - decoded;
+            if (delta > 127) delta = 127;
+            if (delta < -128) delta = -128;
+            burst.channels[ch].deltas[i] = (int8_t)delta;
+            decoded += delta;
+        }
+    }
+    sealFrame(frame);
+
+    uint8_t backIx = burstFrontIx ^ 1;
+    memcpy((void *)&bursts[backIx], &frame, sizeof(frame));
+    burstFrontIx = backIx;
+}
+
+static bool movedBeyond(uint16_t a, uint16_t b, uint16_t threshold)
+{
+    return a > b ? a - b >= threshold : b - a >= threshold;
+}
+
+static void updateAttention()
+{
+    // Snapshot that was sent last becomes the reference; it's not rewritten before the next flip
+    cli();
+    bool acked = attnAcked;
+    attnAcked = false;
+    sei();
+    if (acked) memcpy(&attnRef, (const void *)&snapshots[attnAckedIx].payload, sizeof(InputReadingsEx));
+
+    if (!attnEnabled) return;
+    const volatile InputReadingsEx &cur = snapshots[frontIx].payload;
+    bool moved = movedBeyond(cur.readings.aKnob, attnRef.readings.aKnob, ATTN_THRESHOLD) ||
+                 movedBeyond(cur.readings.bKnob, attnRef.readings.bKnob, ATTN_THRESHOLD) ||
+                 movedBeyond(cur.readings.cKnob, attnRef.readings.cKnob, ATTN_THRESHOLD) ||
+                 movedBeyond(cur.tunerFine, attnRef.tunerFine, ATTN_THRESHOLD) ||
+                 movedBeyond(cur.swtchTicks, attnRef.swtchTicks, ATTN_SWITCH_THRESHOLD);
+    if (moved) digitalWriteFast(ATTN_PIN, LOW);
+}
+
+void handleCommand(const uint8_t *buf)
+{
+    uint8_t cmd = buf[0];
+    uint32_t now = millis();
+    // New fades start from wherever the light is now
+    uint8_t light = lightFade.valueAt(now);
+    if (cmd == CMD_LIGHT_OFF || cmd == CMD_LIGHT_ON)
+    {
+        lightFade.start(light, cmd == CMD_LIGHT_ON ? 255 : 0, 0, now);
+    }
+    else if (cmd == CMD_LIGHT_FADE)
+    {
+        LightFade fade;
+        memcpy(&fade, buf + 1, sizeof(fade));
+        lightFade.start(light, fade.level, fade.duration, now);
+    }
+    else if (cmd == CMD_LIGHT_BREATHE)
     {
-        InputReadings data;
-        cli();
-        data.tuner = tunerLog.getAvg();
-        data.aKnob = aKnobLog.getAvg();
-        data.bKnob = bKnobLog.getAvg();
-        data.cKnob = cKnobLog.getAvg();
-        data.swtch = swtch;
-        sendBytes = sizeof(InputReadings);
-        if (sendBufSz < sendBytes) sendBytes = sendBufSz;
-        memcpy((void *)sendBuf, &data, sendBytes);
-        sei();
+        LightBreathe breathe;
+        memcpy(&breathe, buf + 1, sizeof(breathe));
+        lightFade.breathe(breathe.low, breathe.high, breathe.period, now);
     }
-    else if (cmd == 0x10)
+    else if (cmd == CMD_ATTN_OFF || cmd == CMD_ATTN_ON)
     {
-        digitalWrite(LIGHT_CTRL_PIN, LOW);
+        // Attention mode off/on; the line idles high while off
+        attnEnabled = cmd == CMD_ATTN_ON;
+        digitalWriteFast(ATTN_PIN, HIGH);
     }
-    else if (cmd == 0x11)
+    else if (cmd == CMD_HAPTIC)
     {
-        digitalWrite(LIGHT_CTRL_PIN, HIGH);
+        HapticEnvelope env;
+        memcpy(&env, buf + 1, sizeof(env));
+        haptic.start(env.intensity, env.attack, env.sustain, env.decay, now);
     }
 }
@@ -0,0 +1,66 @@
+#include "attention.h"
+
+// Local dependencies
+#include "error.h"
+
+// Global
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+GpioAttention::GpioAttention(const char *chip_path, int line)
+    : fd(-1)
+{
+    int chip_fd = open(chip_path, O_RDONLY);
+    if (chip_fd < 0) throwf_errno("Failed to open GPIO chip '%s'", chip_path);
+
+    struct gpioevent_request req;
+    memset(&req, 0, sizeof(req));
+    req.lineoffset = line;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+    strncpy(req.consumer_label, "igr-attention", sizeof(req.consumer_label) - 1);
+    int r = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+    int ioctl_errno = errno;
+    close(chip_fd);
+    if (r < 0)
+    {
+        errno = ioctl_errno;
+        throwf_errno("Failed to request events for GPIO line %d", line);
+    }
+
+    // Reads in clear() must not block when events were already consumed
+    fd = req.fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+GpioAttention::~GpioAttention()
+{
+    if (fd != -1) close(fd);
+}
+
+int GpioAttention::get_fd() const
+{
+    return fd;
+}
+
+void GpioAttention::clear()
+{
+    struct gpioevent_data event;
+    while (read(fd, &event, sizeof(event)) == sizeof(event))
+    {
+    }
+}
+
+int PollingAttention::get_fd() const
+{
+    return -1;
+}
+
+void PollingAttention::clear()
+{
+}
@@ -0,0 +1,37 @@
+#ifndef ATTENTION_H
+#define ATTENTION_H
+
+// Tells the hardware controller when the MCU has new input worth reading.
+// Sources with a file descriptor are waited on with poll(); without one, the caller polls the MCU.
+class AttentionSource
+{
+  public:
+    virtual ~AttentionSource() {}
+    // Becomes readable when attention is requested; -1 if the source can't signal
+    virtual int get_fd() const = 0;
+    // Consumes pending events once fd was readable
+    virtual void clear() = 0;
+};
+
+// MCU's attention line, as a falling-edge line event from the GPIO character device
+class GpioAttention : public AttentionSource
+{
+  private:
+    int fd;
+
+  public:
+    GpioAttention(const char *chip_path, int line);
+    ~GpioAttention();
+    int get_fd() const;
+    void clear();
+};
+
+// No attention line: caller falls back to polling at a fixed rate
+class PollingAttention : public AttentionSource
+{
+  public:
+    int get_fd() const;
+    void clear();
+};
+
+#endif
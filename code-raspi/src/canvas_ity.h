@@ -70,8 +70,10 @@
 // - Shares no internal pointers, nor holds any external pointers.  Newcomers
 //     to C++ can have fun drawing with this library without worrying so much
 //     about resource lifetimes or mutability.
-// - Uses no static or global variables.  Threads may safely work with
-//     different canvas instances concurrently without locking.
+// - Uses no static or global variables, other than sRGB lookup tables
+//     that are filled in during static initialization and only read after.
+//     Threads may safely work with different canvas instances concurrently
+//     without locking.
 // - Allocates no dynamic memory after reaching the high-water mark.  Except
 //     for the pixel buffer, flat std::vector instances embedded in the canvas
 //     instance handle all dynamic memory.  This reduces fragmentation and
@@ -189,6 +191,12 @@ enum align_style
     start = 0,
     ending
 };
+enum filter_style
+{
+    nearest,
+    bilinear,
+    bicubic
+};
 enum baseline_style
 {
     alphabetic,
@@ -199,6 +207,15 @@ enum baseline_style
     ideographic = 3
 };
 
+// Public API structs
+struct text_layout
+{
+    std::vector<int> glyphs;
+    std::vector<int> positions;
+    int width;
+    text_layout();
+};
+
 // Implementation details
 struct xy
 {
@@ -232,11 +249,17 @@ struct paint_brush
     int width, height;
     repetition_style repetition;
 };
+struct glyph_range
+{
+    int first, last, offset;
+};
 struct font_face
 {
     std::vector<unsigned char> data;
     int cmap, glyf, head, hhea, hmtx, loca, maxp, os_2;
     float scale;
+    std::vector<unsigned short> latin;
+    std::vector<glyph_range> ranges;
 };
 struct subpath_data
 {
@@ -259,6 +282,12 @@ struct pixel_run
     float delta;
 };
 typedef std::vector<pixel_run> pixel_runs;
+struct fixed_run
+{
+    unsigned short x, y;
+    short delta;
+};
+typedef std::vector<fixed_run> fixed_runs;
 
 class canvas
 {
@@ -418,6 +447,29 @@ class canvas
     ///
     composite_operation global_composite_operation;
 
+    /// @brief  Whether to antialias the edges of new drawing.
+    ///
+    /// This takes effect at the time of drawing, for filling, stroking,
+    /// text, images, shadows, and clipping.  When off, each pixel is either
+    /// fully covered or not at all, according to whether its center is
+    /// inside the shape, and covered spans are filled without any blending
+    /// of partial coverage.  Useful for deliberately blocky graphics, and
+    /// faster.  Defaults to true.
+    ///
+    bool antialiasing;
+
+    /// @brief  Whether to scan-convert antialiased edges in fixed point.
+    ///
+    /// This takes effect at the time of drawing, like antialiasing.  When
+    /// on, the ends of each edge are snapped to 1/64 of a pixel, and the
+    /// coverage of each pixel that the edge touches is accumulated exactly
+    /// in integers rather than in floating point.  The changes in coverage
+    /// are smaller to store and are sorted by radix.  Coverage may differ
+    /// from the floating-point scan conversion by about 1/64 per edge
+    /// crossing a pixel.  Defaults to false.
+    ///
+    bool fixed_point_coverage;
+
     // ======== SHADOWS ========
 
     /// @brief  Set the color and opacity of the shadow.
@@ -1114,8 +1166,76 @@ class canvas
     float measure_text(
         char const *text);
 
+    /// @brief  Lay out a line of text as glyphs to draw again later.
+    ///
+    /// This does the character decoding and glyph lookup and placement part
+    /// of drawing text once, so that the result can be drawn repeatedly
+    /// with fill_glyphs() or stroke_glyphs(), or edited.  Each glyph gets
+    /// its index in the current font and the horizontal position of its
+    /// origin, and the layout gets its total advance width; all of these
+    /// are in font units, so the layout stays valid when only the font size
+    /// changes, but not when the font does.  This replaces the previous
+    /// contents of the layout.  If the text pointer is null, or the font
+    /// has not been set yet, or the last setting of it was unsuccessful,
+    /// the layout is left empty.
+    ///
+    /// @param text    null-terminated UTF-8 string of text to lay out
+    /// @param layout  glyphs and positions of the text, in font units
+    ///
+    void layout_text(
+        char const *text,
+        text_layout &layout);
+
+    /// @brief  Draw a laid out line of text by filling its outline.
+    ///
+    /// This behaves exactly as fill_text() would with the text that the
+    /// layout came from, except that glyph indices beyond the end of the
+    /// current font are skipped.
+    ///
+    /// @param layout         glyphs from layout_text() to fill
+    /// @param x              horizontal coordinate of the anchor point
+    /// @param y              vertical coordinate of the anchor point
+    /// @param maximum_width  horizontal width to condense wider text to
+    ///
+    void fill_glyphs(
+        text_layout const &layout,
+        float x,
+        float y,
+        float maximum_width = 1.0e30f);
+
+    /// @brief  Draw a laid out line of text by stroking its outline.
+    ///
+    /// This behaves exactly as stroke_text() would with the text that the
+    /// layout came from, except that glyph indices beyond the end of the
+    /// current font are skipped.
+    ///
+    /// @param layout         glyphs from layout_text() to stroke
+    /// @param x              horizontal coordinate of the anchor point
+    /// @param y              vertical coordinate of the anchor point
+    /// @param maximum_width  horizontal width to condense wider text to
+    ///
+    void stroke_glyphs(
+        text_layout const &layout,
+        float x,
+        float y,
+        float maximum_width = 1.0e30f);
+
     // ======== DRAWING IMAGES ========
 
+    /// @brief  Filter for resampling images and patterns.
+    ///
+    /// This takes effect at the time of drawing, for both draw_image() and
+    /// filling or stroking with a pattern.  Where the current transform is
+    /// only a translation by whole pixels, there is nothing to resample and
+    /// all filters give the same result; pixels are then copied straight
+    /// from the image rows.  Defaults to bicubic.
+    ///
+    /// nearest:   Take the closest pixel; blocky, but fastest.
+    /// bilinear:  Blend the four closest pixels; aliases when minifying.
+    /// bicubic:   Catmull-Rom convolution, widened when minifying.
+    ///
+    filter_style image_filter;
+
     /// @brief  Draw an image onto the canvas.
     ///
     /// The position of the rectangle that the image is drawn to is affected
@@ -1153,6 +1273,28 @@ class canvas
         float to_width,
         float to_height);
 
+    /// @brief  Draw another canvas onto this one, as an offscreen layer.
+    ///
+    /// This behaves as draw_image() would with the layer's contents at its
+    /// own size, except that the pixels are taken as they are kept inside
+    /// the layer, without the round trip through sRGB and 8 bits that
+    /// get_image_data() and put_image_data() would make.  Content drawn into
+    /// a layer once can so be composited cheaply every frame; where the
+    /// current transform is a translation by whole pixels, this comes down
+    /// to one blend per pixel.  The layer is not changed, but it is briefly
+    /// borrowed from, so it must not be this canvas itself, in which case
+    /// this does nothing.  Nor does it if the current transform is not
+    /// invertible or the layer is empty.
+    ///
+    /// @param layer  canvas whose contents to draw
+    /// @param x      horizontal coordinate to draw the layer's corner at
+    /// @param y      vertical coordinate to draw the layer's corner at
+    ///
+    void draw_layer(
+        canvas &layer,
+        float x,
+        float y);
+
     // ======== PIXEL MANIPULATION ========
 
     /// @brief  Fetch a rectangle of pixels from the canvas to an image.
@@ -1263,9 +1405,16 @@ class canvas
     line_path lines;
     line_path scratch;
     pixel_runs runs;
+    fixed_runs cells;
+    fixed_runs sorted_cells;
     pixel_runs mask;
+    std::vector<size_t> mask_rows;
+    std::vector<size_t> run_rows;
+    xy mask_minimum;
+    xy mask_maximum;
     font_face face;
-    rgba *bitmap;
+    text_layout layout;
+    std::vector<rgba> bitmap;
     canvas *saves;
     canvas(canvas const &);
     canvas &operator=(canvas const &);
@@ -1273,12 +1422,18 @@ class canvas
     void add_bezier(xy, xy, xy, xy, float);
     void path_to_lines(bool);
     void add_glyph(int, float);
+    void build_glyph_map();
     int character_to_glyph(char const *, int &);
-    void text_to_lines(char const *, xy, float, bool);
+    void text_to_lines(text_layout const &, xy, float, bool);
     void dash_lines();
     void add_half_stroke(size_t, size_t, bool);
     void stroke_lines();
     void add_runs(xy, xy);
+    void add_aliased_runs(xy, xy);
+    void add_cell(int, int, int, int);
+    void add_fixed_row(int, int, int, int, int);
+    void add_fixed_runs(xy, xy);
+    void cells_to_runs();
     void lines_to_runs(xy, int);
     rgba paint_pixel(xy, paint_brush const &);
     void render_shadow(paint_brush const &);
@@ -1457,10 +1612,46 @@ static float delinearized(float value)
 {
     return value < 0.0031308f ? 12.92f * value : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
 }
+
+// Lookup tables for converting to and from sRGB in bulk.  Image data only
+// comes in as 8 bits per channel, so a table of 256 makes linearizing it
+// exact.  For output, 4096 intervals interpolated linearly stay within a
+// hundredth of an 8-bit step of the exact curve.  Both get filled in once
+// during static initialization, before any canvas can be drawn into.
+static float linearize_table[256];
+static float delinearize_table[4097];
+struct srgb_tables
+{
+    srgb_tables();
+};
+srgb_tables::srgb_tables()
+{
+    for (int index = 0; index < 256; ++index)
+        linearize_table[index] =
+            linearized(static_cast<float>(index) / 255.0f);
+    for (int index = 0; index <= 4096; ++index)
+        delinearize_table[index] =
+            delinearized(static_cast<float>(index) / 4096.0f);
+}
+static srgb_tables const srgb_tables_filled;
+static rgba const linearized(unsigned char const *pixel)
+{
+    return rgba(linearize_table[pixel[0]], linearize_table[pixel[1]],
+                linearize_table[pixel[2]], pixel[3] / 255.0f);
+}
 static rgba const delinearized(rgba that)
 {
-    return rgba(delinearized(that.r), delinearized(that.g),
-                delinearized(that.b), that.a);
+    float channels[] = {that.r, that.g, that.b};
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        float place = channels[channel] * 4096.0f;
+        int index = std::min(static_cast<int>(place), 4095);
+        float low = delinearize_table[index];
+        float high = delinearize_table[index + 1];
+        channels[channel] = low + (place - static_cast<float>(index)) *
+                                      (high - low);
+    }
+    return rgba(channels[0], channels[1], channels[2], that.a);
 }
 static rgba const unpremultiplied(rgba that)
 {
@@ -1475,6 +1666,12 @@ static rgba const clamped(rgba that)
                 std::min(std::max(that.a, 0.0f), 1.0f));
 }
 
+// Text layouts
+text_layout::text_layout()
+    : width(0)
+{
+}
+
 // Helpers for TTF file parsing
 static int unsigned_8(std::vector<unsigned char> &data, int index)
 {
@@ -1501,6 +1698,28 @@ static int signed_32(std::vector<unsigned char> &data, int index)
     return (data[place + 0] << 24 | data[place + 1] << 16 |
             data[place + 2] << 8 | data[place + 3] << 0);
 }
+static bool operator<(
+    glyph_range left,
+    glyph_range right)
+{
+    return left.first < right.first;
+}
+static int range_to_glyph(std::vector<glyph_range> &ranges, int codepoint)
+{
+    size_t low = 0;
+    size_t high = ranges.size();
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (ranges[middle].last < codepoint)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == ranges.size() || codepoint < ranges[low].first)
+        return 0;
+    return (codepoint + ranges[low].offset) & 0xffff;
+}
 
 // Tessellate (at low-level) a cubic Bezier curve and add it to the polyline
 // data.  This recursively splits the curve until two criteria are met
@@ -1880,39 +2099,21 @@ void canvas::add_glyph(
     }
 }
 
-// Decode the next codepoint from a null-terminated UTF-8 string to its glyph
-// index within the font.  The index to the next codepoint in the string
-// is advanced accordingly.  It checks for valid UTF-8 encoding, but not
-// for valid unicode codepoints.  Where it finds an invalid encoding, it
-// decodes it as the Unicode replacement character (U+FFFD) and advances to
-// the invalid byte, per Unicode recommendation.  It also replaces low-ASCII
-// whitespace characters with regular spaces.  After decoding the codepoint,
-// it looks up the corresponding glyph index from the current font's character
-// map table, returning a glyph index of 0 for the .notdef character (i.e.,
-// "tofu") if the font lacks a glyph for that codepoint.
+// Build the lookup tables for mapping codepoints to glyph indices from the
+// font's character map, so that decoding text never has to walk the cmap.
+// It prefers a format 12 subtable (full Unicode), then format 4 (BMP), and
+// then format 0 (single byte).  Each group or segment that maps directly
+// becomes a range with a constant offset from codepoint to glyph; segments
+// that go through the glyph index array become a run of single-codepoint
+// ranges, merged where neighbors share an offset.  The ranges are sorted by
+// codepoint and any overlap (only in malformed fonts) is clipped off so that
+// a binary search can find them.  Codepoints below 256 also get copied into
+// a direct table, since those are by far the most common.
 //
-int canvas::character_to_glyph(
-    char const *text,
-    int &index)
+void canvas::build_glyph_map()
 {
-    int bytes = ((text[index] & 0x80) == 0x00 ? 1 : (text[index] & 0xe0) == 0xc0 ? 2
-                                                : (text[index] & 0xf0) == 0xe0   ? 3
-                                                : (text[index] & 0xf8) == 0xf0   ? 4
-                                                                                 : 0);
-    int const masks[] = {0x0, 0x7f, 0x1f, 0x0f, 0x07};
-    int codepoint = bytes ? text[index] & masks[bytes] : 0xfffd;
-    ++index;
-    while (--bytes > 0)
-        if ((text[index] & 0xc0) == 0x80)
-            codepoint = codepoint << 6 | (text[index++] & 0x3f);
-        else
-        {
-            codepoint = 0xfffd;
-            break;
-        }
-    if (codepoint == '\t' || codepoint == '\v' || codepoint == '\f' ||
-        codepoint == '\r' || codepoint == '\n')
-        codepoint = ' ';
+    face.latin.assign(256, 0);
+    face.ranges.clear();
     int tables = unsigned_16(face.data, face.cmap + 2);
     int format_12 = 0;
     int format_4 = 0;
@@ -1938,8 +2139,8 @@ int canvas::character_to_glyph(
             int start = signed_32(face.data, format_12 + 16 + group * 12);
             int end = signed_32(face.data, format_12 + 20 + group * 12);
             int glyph = signed_32(face.data, format_12 + 24 + group * 12);
-            if (start <= codepoint && codepoint <= end)
-                return codepoint - start + glyph;
+            glyph_range range = {start, end, glyph - start};
+            face.ranges.push_back(range);
         }
     }
     else if (format_4)
@@ -1955,26 +2156,99 @@ int canvas::character_to_glyph(
             int end = unsigned_16(face.data, end_array + segment);
             int delta = signed_16(face.data, delta_array + segment);
             int range = unsigned_16(face.data, range_array + segment);
-            if (start <= codepoint && codepoint <= end)
-                return range ? unsigned_16(face.data, range_array + segment +
-                                                          (codepoint - start) * 2 + range)
-                             : (codepoint + delta) & 0xffff;
+            if (!range)
+            {
+                glyph_range entry = {start, end, delta};
+                face.ranges.push_back(entry);
+                continue;
+            }
+            for (int codepoint = start; codepoint <= end; ++codepoint)
+            {
+                int glyph = unsigned_16(face.data, range_array + segment +
+                                                       (codepoint - start) * 2 + range);
+                glyph_range entry = {codepoint, codepoint, glyph - codepoint};
+                if (codepoint != start &&
+                    face.ranges.back().offset == entry.offset)
+                    face.ranges.back().last = codepoint;
+                else
+                    face.ranges.push_back(entry);
+            }
         }
     }
-    else if (format_0 && 0 <= codepoint && codepoint < 256)
-        return unsigned_8(face.data, format_0 + 6 + codepoint);
-    return 0;
+    else if (format_0)
+    {
+        for (int codepoint = 0; codepoint < 256; ++codepoint)
+            face.latin[codepoint] = static_cast<unsigned short>(
+                unsigned_8(face.data, format_0 + 6 + codepoint));
+        return;
+    }
+    std::stable_sort(face.ranges.begin(), face.ranges.end());
+    size_t kept = 0;
+    for (size_t index = 0; index < face.ranges.size(); ++index)
+    {
+        glyph_range range = face.ranges[index];
+        if (kept && range.first <= face.ranges[kept - 1].last)
+        {
+            range.first = face.ranges[kept - 1].last + 1;
+            if (range.first > range.last)
+                continue;
+        }
+        face.ranges[kept++] = range;
+    }
+    face.ranges.resize(kept);
+    for (int codepoint = 0; codepoint < 256; ++codepoint)
+        face.latin[codepoint] = static_cast<unsigned short>(
+            range_to_glyph(face.ranges, codepoint));
 }
 
-// Convert a text string to a set of polylines.  This works out the placement
-// of the text string relative to the anchor position.  Then it walks through
-// the string, sizing and placing each character by temporarily changing the
-// current transform matrix to map from font units to canvas pixel coordinates
-// before adding the glyph to the polylines.  This replaces the previous
-// polyline data.
+// Decode the next codepoint from a null-terminated UTF-8 string to its glyph
+// index within the font.  The index to the next codepoint in the string
+// is advanced accordingly.  It checks for valid UTF-8 encoding, but not
+// for valid unicode codepoints.  Where it finds an invalid encoding, it
+// decodes it as the Unicode replacement character (U+FFFD) and advances to
+// the invalid byte, per Unicode recommendation.  It also replaces low-ASCII
+// whitespace characters with regular spaces.  After decoding the codepoint,
+// it looks up the corresponding glyph index from the tables that set_font()
+// built from the font's character map, returning a glyph index of 0 for
+// the .notdef character (i.e., "tofu") if the font lacks a glyph for that
+// codepoint.
 //
-void canvas::text_to_lines(
+int canvas::character_to_glyph(
     char const *text,
+    int &index)
+{
+    int bytes = ((text[index] & 0x80) == 0x00 ? 1 : (text[index] & 0xe0) == 0xc0 ? 2
+                                                : (text[index] & 0xf0) == 0xe0   ? 3
+                                                : (text[index] & 0xf8) == 0xf0   ? 4
+                                                                                 : 0);
+    int const masks[] = {0x0, 0x7f, 0x1f, 0x0f, 0x07};
+    int codepoint = bytes ? text[index] & masks[bytes] : 0xfffd;
+    ++index;
+    while (--bytes > 0)
+        if ((text[index] & 0xc0) == 0x80)
+            codepoint = codepoint << 6 | (text[index++] & 0x3f);
+        else
+        {
+            codepoint = 0xfffd;
+            break;
+        }
+    if (codepoint == '\t' || codepoint == '\v' || codepoint == '\f' ||
+        codepoint == '\r' || codepoint == '\n')
+        codepoint = ' ';
+    if (codepoint < 256)
+        return face.latin[static_cast<size_t>(codepoint)];
+    return range_to_glyph(face.ranges, codepoint);
+}
+
+// Convert laid out text to a set of polylines.  This works out the placement
+// of the text relative to the anchor position.  Then it walks through the
+// glyphs, sizing and placing each one by temporarily changing the current
+// transform matrix to map from font units to canvas pixel coordinates before
+// adding the glyph to the polylines.  This replaces the previous polyline
+// data.
+//
+void canvas::text_to_lines(
+    text_layout const &glyphs,
     xy position,
     float maximum_width,
     bool stroking)
@@ -1984,9 +2258,9 @@ void canvas::text_to_lines(
     float angular = stroking ? (ratio - 2.0f) * ratio * 2.0f + 1.0f : -1.0f;
     lines.points.clear();
     lines.subpaths.clear();
-    if (face.data.empty() || !text || maximum_width <= 0.0f)
+    if (face.data.empty() || glyphs.glyphs.empty() || maximum_width <= 0.0f)
         return;
-    float width = maximum_width == 1.0e30f && text_align == leftward ? 0.0f : measure_text(text);
+    float width = static_cast<float>(glyphs.width) * face.scale;
     float reduction = maximum_width / std::max(maximum_width, width);
     if (text_align == rightward)
         position.x -= width * reduction;
@@ -2010,18 +2284,17 @@ void canvas::text_to_lines(
         position.y += 0.6f * face.scale * units_per_em;
     affine_matrix saved_forward = forward;
     affine_matrix saved_inverse = inverse;
-    int hmetrics = unsigned_16(face.data, face.hhea + 34);
-    int place = 0;
-    for (int index = 0; text[index];)
+    int count = unsigned_16(face.data, face.maxp + 4);
+    for (size_t index = 0; index < glyphs.glyphs.size(); ++index)
     {
-        int glyph = character_to_glyph(text, index);
+        int glyph = glyphs.glyphs[index];
+        if (glyph < 0 || count <= glyph)
+            continue;
+        float place = static_cast<float>(glyphs.positions[index]);
         forward = saved_forward;
         transform(scaling.x, 0.0f, 0.0f, -scaling.y,
-                  position.x + static_cast<float>(place) * scaling.x,
-                  position.y);
+                  position.x + place * scaling.x, position.y);
         add_glyph(glyph, angular);
-        int entry = std::min(glyph, hmetrics - 1);
-        place += unsigned_16(face.data, face.hmtx + entry * 4);
     }
     forward = saved_forward;
     inverse = saved_inverse;
@@ -2290,6 +2563,16 @@ void canvas::add_runs(
     xy from,
     xy to)
 {
+    if (!antialiasing)
+    {
+        add_aliased_runs(from, to);
+        return;
+    }
+    if (fixed_point_coverage)
+    {
+        add_fixed_runs(from, to);
+        return;
+    }
     static float const epsilon = 2.0e-5f;
     if (fabsf(to.y - from.y) < epsilon)
         return;
@@ -2350,6 +2633,252 @@ void canvas::add_runs(
     } while (now.y != to.y);
 }
 
+// Scan-convert a single polyline segment without antialiasing.  For each
+// row whose pixel centers lie in the segment's vertical span (including the
+// top end but not the bottom), it finds where the segment crosses the row
+// at the center height and adds one whole change in coverage at the first
+// pixel whose center lies right of it.  The result therefore sums to whole
+// windings, and every pixel is either fully covered or not at all.
+//
+void canvas::add_aliased_runs(
+    xy from,
+    xy to)
+{
+    float sign = to.y > from.y ? 1.0f : -1.0f;
+    if (from.y > to.y)
+        std::swap(from, to);
+    int first = static_cast<int>(ceilf(from.y - 0.5f));
+    int last = static_cast<int>(ceilf(to.y - 0.5f));
+    if (first >= last)
+        return;
+    float slope = (to.x - from.x) / (to.y - from.y);
+    for (int y = first; y < last; ++y)
+    {
+        float x = from.x + (static_cast<float>(y) + 0.5f - from.y) * slope;
+        pixel_run piece = {static_cast<unsigned short>(
+                               std::max(ceilf(x - 0.5f), 0.0f)),
+                           static_cast<unsigned short>(y), sign};
+        runs.push_back(piece);
+    }
+}
+
+// Fixed-point scan conversion works in units of 1/64 of a pixel, with the
+// same signed trapezoidal areas as the floating-point version.  Each pixel
+// that an edge touches is a cell, given the cover (the signed height of the
+// edge within the cell) and the area (the height times twice the average
+// distance from the left side of the cell).  Both are exact integers, so
+// sums over any number of edges carry no rounding error.  A cell becomes a
+// change in coverage of the cell's pixel and the one to its right, in units
+// of 1/8192; one edge never changes a pixel by more than the full amount,
+// so each fits in 16 bits.  See "The FreeType Project" gray rasterizer and
+// "libart" for the cell formulation.
+//
+static int const subpixels = 64;
+
+void canvas::add_cell(
+    int x,
+    int y,
+    int cover,
+    int area)
+{
+    if (cover == 0 && area == 0)
+        return;
+    fixed_run piece_1 = {static_cast<unsigned short>(x),
+                         static_cast<unsigned short>(y),
+                         static_cast<short>(2 * subpixels * cover - area)};
+    fixed_run piece_2 = {static_cast<unsigned short>(x + 1),
+                         static_cast<unsigned short>(y),
+                         static_cast<short>(area)};
+    cells.push_back(piece_1);
+    cells.push_back(piece_2);
+}
+
+// Convert the part of an edge within a single row of pixels to cells.  The
+// horizontal positions are absolute and the vertical ones are relative to
+// the top of the row.  Rather than dividing at every cell, it steps across
+// the cells with an integer quotient and remainder, as with Bresenham's
+// line algorithm.
+//
+void canvas::add_fixed_row(
+    int y,
+    int x_1,
+    int y_1,
+    int x_2,
+    int y_2)
+{
+    if (y_1 == y_2)
+        return;
+    int cell_1 = x_1 / subpixels;
+    int cell_2 = x_2 / subpixels;
+    int fraction_1 = x_1 - cell_1 * subpixels;
+    int fraction_2 = x_2 - cell_2 * subpixels;
+    if (cell_1 == cell_2)
+    {
+        add_cell(cell_1, y, y_2 - y_1, (fraction_1 + fraction_2) * (y_2 - y_1));
+        return;
+    }
+    int dx = x_2 - x_1;
+    int product = (subpixels - fraction_1) * (y_2 - y_1);
+    int first = subpixels;
+    int step = 1;
+    if (dx < 0)
+    {
+        product = fraction_1 * (y_2 - y_1);
+        first = 0;
+        step = -1;
+        dx = -dx;
+    }
+    int delta = product / dx;
+    int error = product % dx;
+    if (error < 0)
+    {
+        --delta;
+        error += dx;
+    }
+    add_cell(cell_1, y, delta, (fraction_1 + first) * delta);
+    int lift = 0;
+    int remainder = 0;
+    if (cell_1 + step != cell_2)
+    {
+        product = subpixels * (y_2 - y_1);
+        lift = product / dx;
+        remainder = product % dx;
+        if (remainder < 0)
+        {
+            --lift;
+            remainder += dx;
+        }
+        error -= dx;
+    }
+    y_1 += delta;
+    for (cell_1 += step; cell_1 != cell_2; cell_1 += step)
+    {
+        delta = lift;
+        error += remainder;
+        if (error >= 0)
+        {
+            error -= dx;
+            ++delta;
+        }
+        add_cell(cell_1, y, delta, subpixels * delta);
+        y_1 += delta;
+    }
+    add_cell(cell_2, y, y_2 - y_1, (fraction_2 + subpixels - first) * (y_2 - y_1));
+}
+
+// Scan-convert a single polyline segment in fixed point.  It snaps the ends
+// to the subpixel grid, then steps from row to row the same way that each
+// row steps from cell to cell, handing the part within each row over to be
+// split into cells.  Like add_runs(), this does not clip to the screen.
+//
+void canvas::add_fixed_runs(
+    xy from,
+    xy to)
+{
+    int x_1 = static_cast<int>(from.x * subpixels + 0.5f);
+    int y_1 = static_cast<int>(from.y * subpixels + 0.5f);
+    int x_2 = static_cast<int>(to.x * subpixels + 0.5f);
+    int y_2 = static_cast<int>(to.y * subpixels + 0.5f);
+    int row_1 = y_1 / subpixels;
+    int row_2 = y_2 / subpixels;
+    int fraction_1 = y_1 - row_1 * subpixels;
+    int fraction_2 = y_2 - row_2 * subpixels;
+    if (row_1 == row_2)
+    {
+        add_fixed_row(row_1, x_1, fraction_1, x_2, fraction_2);
+        return;
+    }
+    int dx = x_2 - x_1;
+    int dy = y_2 - y_1;
+    int product = (subpixels - fraction_1) * dx;
+    int first = subpixels;
+    int step = 1;
+    if (dy < 0)
+    {
+        product = fraction_1 * dx;
+        first = 0;
+        step = -1;
+        dy = -dy;
+    }
+    int delta = product / dy;
+    int error = product % dy;
+    if (error < 0)
+    {
+        --delta;
+        error += dy;
+    }
+    int x = x_1 + delta;
+    add_fixed_row(row_1, x_1, fraction_1, x, first);
+    int lift = 0;
+    int remainder = 0;
+    if (row_1 + step != row_2)
+    {
+        product = subpixels * dx;
+        lift = product / dy;
+        remainder = product % dy;
+        if (remainder < 0)
+        {
+            --lift;
+            remainder += dy;
+        }
+        error -= dy;
+    }
+    for (row_1 += step; row_1 != row_2; row_1 += step)
+    {
+        delta = lift;
+        error += remainder;
+        if (error >= 0)
+        {
+            error -= dy;
+            ++delta;
+        }
+        add_fixed_row(row_1, x, subpixels - first, x + delta, first);
+        x += delta;
+    }
+    add_fixed_row(row_2, x, subpixels - first, x_2, fraction_2);
+}
+
+// Sort the cells into left-to-right, top-to-bottom order and sum the ones
+// for the same pixel into runs.  The sort is a least significant digit
+// radix sort on the bytes of the column and row, skipping any byte that is
+// the same for all cells; this is stable, though the order of cells for the
+// same pixel would not matter anyway since integer sums are exact.
+//
+void canvas::cells_to_runs()
+{
+    sorted_cells.resize(cells.size());
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        size_t counts[257] = {0};
+        int shift = (pass & 1) * 8;
+        for (size_t index = 0; index < cells.size(); ++index)
+            ++counts[((pass < 2 ? cells[index].x : cells[index].y) >> shift & 255) + 1];
+        if (counts[((pass < 2 ? cells.front().x : cells.front().y) >> shift & 255) + 1] ==
+            cells.size())
+            continue;
+        for (int digit = 0; digit < 256; ++digit)
+            counts[digit + 1] += counts[digit];
+        for (size_t index = 0; index < cells.size(); ++index)
+            sorted_cells[counts[(pass < 2 ? cells[index].x : cells[index].y) >> shift & 255]++] =
+                cells[index];
+        cells.swap(sorted_cells);
+    }
+    static float const scale = 1.0f / static_cast<float>(2 * subpixels * subpixels);
+    for (size_t index = 0; index < cells.size();)
+    {
+        fixed_run cell = cells[index];
+        int sum = 0;
+        for (; index < cells.size() && cells[index].x == cell.x &&
+               cells[index].y == cell.y;
+             ++index)
+            sum += cells[index].delta;
+        if (sum == 0)
+            continue;
+        pixel_run piece = {cell.x, cell.y, static_cast<float>(sum) * scale};
+        runs.push_back(piece);
+    }
+}
+
 static bool operator<(
     pixel_run left,
     pixel_run right)
@@ -2360,28 +2889,79 @@ static bool operator<(
                                                        : fabsf(left.delta) < fabsf(right.delta));
 }
 
+// Build a row-start table over a sorted list of runs: entry y is the index
+// of the first run on row y or below, and the last entry is the end of the
+// list.  Walks over the runs can then start at any row and stop after any
+// other row, rather than scanning in from the top of the list.
+//
+static void index_rows(
+    pixel_runs const &runs,
+    std::vector<size_t> &rows,
+    int height)
+{
+    rows.resize(static_cast<size_t>(height) + 1);
+    size_t index = 0;
+    for (int y = 0; y <= height; ++y)
+    {
+        while (index < runs.size() && runs[index].y < y)
+            ++index;
+        rows[static_cast<size_t>(y)] = index;
+    }
+}
+
 // Scan-convert the polylines to prepare them for antialiased rendering.
-// For each of the polyline loops, it first clips them to the screen.
-// See "Reentrant Polygon Clipping" by Sutherland and Hodgman for details.
+// For each of the polyline loops, it first checks its bounding box.  Loops
+// entirely outside the screen, or (when not padded for a shadow) entirely
+// outside the bounds of the clip mask, are skipped: a closed loop adds no
+// coverage to pixels beyond its bounds.  Loops entirely on screen are taken
+// as they are, and the rest get clipped to the screen.  See "Reentrant
+// Polygon Clipping" by Sutherland and Hodgman for details.
 // Then it walks the polyline loop and scan-converts each line segment to
 // produce a list of changes in signed pixel coverage when processed in
 // left-to-right, top-to-bottom order.  The list of changes is then sorted
 // into that order, and multiple changes to the same pixel are coalesced
-// by summation.  The result is a sparse, run-length encoded description
-// of the coverage of each pixel to be drawn.
+// by summation.  In fixed point, the cells are sorted and coalesced
+// instead.  The result is a sparse, run-length encoded description of the
+// coverage of each pixel to be drawn.
 //
 void canvas::lines_to_runs(
     xy offset,
     int padding)
 {
     runs.clear();
+    cells.clear();
     float width = static_cast<float>(size_x + padding);
     float height = static_cast<float>(size_y + padding);
+    xy low = padding ? xy(0.0f, 0.0f) : mask_minimum;
+    xy high = padding ? xy(width, height) : mask_maximum;
     size_t ending = 0;
     for (size_t subpath = 0; subpath < lines.subpaths.size(); ++subpath)
     {
         size_t beginning = ending;
         ending += lines.subpaths[subpath].count;
+        if (beginning == ending)
+            continue;
+        xy minimum = offset + lines.points[beginning];
+        xy maximum = minimum;
+        for (size_t index = beginning + 1; index < ending; ++index)
+        {
+            xy point = offset + lines.points[index];
+            minimum = xy(std::min(minimum.x, point.x),
+                         std::min(minimum.y, point.y));
+            maximum = xy(std::max(maximum.x, point.x),
+                         std::max(maximum.y, point.y));
+        }
+        if (maximum.x < low.x || high.x < minimum.x ||
+            maximum.y < low.y || high.y < minimum.y)
+            continue;
+        if (0.0f <= minimum.x && maximum.x <= width &&
+            0.0f <= minimum.y && maximum.y <= height)
+        {
+            for (size_t index = beginning; index < ending; ++index)
+                add_runs(offset + lines.points[(index != beginning ? index : ending) - 1],
+                         offset + lines.points[index]);
+            continue;
+        }
         scratch.points.clear();
         for (size_t index = beginning; index < ending; ++index)
             scratch.points.push_back(offset + lines.points[index]);
@@ -2421,6 +3001,11 @@ void canvas::lines_to_runs(
                         std::min(std::max(to.y, 0.0f), height)));
         }
     }
+    if (!cells.empty())
+    {
+        cells_to_runs();
+        return;
+    }
     if (runs.empty())
         return;
     std::sort(runs.begin(), runs.end());
@@ -2435,6 +3020,49 @@ void canvas::lines_to_runs(
                runs.end());
 }
 
+// Find a pixel of a pattern or image brush, with coordinates beyond its
+// edges either wrapped around or clamped to the nearest edge.
+//
+static size_t texel_index(
+    paint_brush const &brush,
+    bool clamp,
+    int x,
+    int y)
+{
+    if (clamp)
+    {
+        x = std::min(std::max(x, 0), brush.width - 1);
+        y = std::min(std::max(y, 0), brush.height - 1);
+    }
+    else
+    {
+        x %= brush.width;
+        y %= brush.height;
+        x += x < 0 ? brush.width : 0;
+        y += y < 0 ? brush.height : 0;
+    }
+    return static_cast<size_t>(y * brush.width + x);
+}
+static rgba const &texel(
+    paint_brush const &brush,
+    bool clamp,
+    int x,
+    int y)
+{
+    return brush.colors[texel_index(brush, clamp, x, y)];
+}
+
+// Check whether a transform only moves pixel centers onto pixel centers.
+// Every resampling filter then reduces to exactly the nearest pixel.
+//
+static bool integer_translation(
+    affine_matrix const &matrix)
+{
+    return (matrix.a == 1.0f && matrix.b == 0.0f &&
+            matrix.c == 0.0f && matrix.d == 1.0f &&
+            matrix.e == floorf(matrix.e) && matrix.f == floorf(matrix.f));
+}
+
 // Paint a pixel according to its point location and a paint style to produce
 // a premultiplied, linearized RGBA color.  This handles all supported paint
 // styles: solid colors, linear gradients, radial gradients, and patterns.
@@ -2463,6 +3091,26 @@ rgba canvas::paint_pixel(
             ((brush.repetition & 1) &&
              (point.y < 0.0f || height <= point.y)))
             return rgba(0.0f, 0.0f, 0.0f, 0.0f);
+        bool clamp = &brush == &image_brush;
+        int filter = integer_translation(inverse) ? nearest : image_filter;
+        if (filter == nearest)
+            return texel(brush, clamp, static_cast<int>(floorf(point.x)),
+                         static_cast<int>(floorf(point.y)));
+        if (filter == bilinear)
+        {
+            point -= xy(0.5f, 0.5f);
+            float left = floorf(point.x);
+            float top = floorf(point.y);
+            float mix_x = point.x - left;
+            float mix_y = point.y - top;
+            int x = static_cast<int>(left);
+            int y = static_cast<int>(top);
+            rgba upper = texel(brush, clamp, x, y);
+            rgba lower = texel(brush, clamp, x, y + 1);
+            upper += mix_x * (texel(brush, clamp, x + 1, y) - upper);
+            lower += mix_x * (texel(brush, clamp, x + 1, y + 1) - lower);
+            return upper + mix_y * (lower - upper);
+        }
         float scale_x = fabsf(inverse.a) + fabsf(inverse.c);
         float scale_y = fabsf(inverse.b) + fabsf(inverse.d);
         scale_x = std::max(1.0f, std::min(scale_x, width * 0.25f));
@@ -2686,7 +3334,9 @@ void canvas::render_shadow(
     int x = -1;
     int y = -1;
     float sum = 0.0f;
-    for (size_t index = 0; index < mask.size(); ++index)
+    size_t first = static_cast<size_t>(std::min(std::max(top - border, 0), size_y));
+    size_t last = static_cast<size_t>(std::min(std::max(bottom - border, 0), size_y));
+    for (size_t index = mask_rows[first]; index < mask_rows[std::max(first, last)]; ++index)
     {
         pixel_run next = mask[index];
         float visibility = std::min(fabsf(sum), 1.0f);
@@ -2726,7 +3376,12 @@ void canvas::render_shadow(
 // to the current compositing settings.  This is slightly more complicated
 // because it interleaves this with a simultaneous scan through a similar
 // set of runs representing the current clip mask to determine which pixels
-// it can composite into.  Note that shadows are always drawn first.
+// it can composite into.  Unless the compositing settings require clearing
+// outside the shape, both scans start at the first row with coverage inside
+// the clip mask and stop after the last, using the row-start tables.  Where
+// a pattern or image is only shifted by whole pixels, it skips resampling
+// and walks along the image row directly.  Note that shadows are always
+// drawn first.
 //
 void canvas::render_main(
     paint_brush const &brush)
@@ -2736,13 +3391,33 @@ void canvas::render_main(
     render_shadow(brush);
     lines_to_runs(xy(0.0f, 0.0f), 0);
     int operation = global_composite_operation;
+    int first = 0;
+    int last = size_y;
+    if (operation & 8)
+    {
+        if (runs.empty())
+            return;
+        first = std::max(static_cast<int>(runs.front().y),
+                         static_cast<int>(mask_minimum.y));
+        last = std::min(static_cast<int>(runs.back().y) + 1,
+                        static_cast<int>(mask_maximum.y));
+        if (first >= last)
+            return;
+    }
+    index_rows(runs, run_rows, size_y);
+    bool aligned = (brush.type == paint_brush::pattern &&
+                    !brush.colors.empty() && integer_translation(inverse));
+    bool clamp = &brush == &image_brush;
+    int shift_x = static_cast<int>(inverse.e);
+    int shift_y = static_cast<int>(inverse.f);
     int x = -1;
     int y = -1;
     float path_sum = 0.0f;
     float clip_sum = 0.0f;
-    size_t path_index = 0;
-    size_t clip_index = 0;
-    while (clip_index < mask.size())
+    size_t path_index = run_rows[static_cast<size_t>(first)];
+    size_t clip_index = mask_rows[static_cast<size_t>(first)];
+    size_t clip_end = mask_rows[static_cast<size_t>(last)];
+    while (clip_index < clip_end)
     {
         bool which = (path_index < runs.size() &&
                       runs[path_index] < mask[clip_index]);
@@ -2751,15 +3426,48 @@ void canvas::render_main(
         float visibility = std::min(fabsf(clip_sum), 1.0f);
         int to = next.y == y ? next.x : x + 1;
         static float const threshold = 1.0f / 8160.0f;
+        if (coverage == 1.0f && visibility == 1.0f &&
+            operation == source_over && brush.type == paint_brush::color &&
+            !brush.colors.empty())
+        {
+            rgba fore = global_alpha * brush.colors.front();
+            if (fore.a == 1.0f)
+                for (; x < to; ++x)
+                    bitmap[y * size_x + x] = fore;
+        }
         if ((coverage >= threshold || ~operation & 8) &&
             visibility >= threshold)
+        {
+            int source_y = y + shift_y;
+            bool inside_y = clamp || ~brush.repetition & 1 ||
+                            (0 <= source_y && source_y < brush.height);
+            int column = 0;
+            size_t row = 0;
+            if (aligned)
+            {
+                size_t index = texel_index(brush, clamp, x + shift_x, source_y);
+                column = static_cast<int>(index % static_cast<size_t>(brush.width));
+                row = index - static_cast<size_t>(column);
+            }
             for (; x < to; ++x)
             {
                 rgba &back = bitmap[y * size_x + x];
-                rgba fore = coverage * global_alpha *
-                            paint_pixel(xy(static_cast<float>(x) + 0.5f,
+                rgba paint;
+                if (!aligned)
+                    paint = paint_pixel(xy(static_cast<float>(x) + 0.5f,
                                            static_cast<float>(y) + 0.5f),
                                         brush);
+                else
+                {
+                    int source_x = x + shift_x;
+                    if (inside_y && (clamp || ~brush.repetition & 2 ||
+                                     (0 <= source_x && source_x < brush.width)))
+                        paint = brush.colors[row + static_cast<size_t>(column)];
+                    column = (clamp ? std::min(std::max(source_x + 1, 0), brush.width - 1)
+                              : column + 1 == brush.width ? 0
+                                                          : column + 1);
+                }
+                rgba fore = coverage * global_alpha * paint;
                 float mix_fore = operation & 1 ? back.a : 0.0f;
                 if (operation & 2)
                     mix_fore = 1.0f - mix_fore;
@@ -2770,6 +3478,7 @@ void canvas::render_main(
                 blend.a = std::min(blend.a, 1.0f);
                 back = visibility * blend + (1.0f - visibility) * back;
             }
+        }
         x = next.x;
         if (next.y != y)
         {
@@ -2788,6 +3497,8 @@ canvas::canvas(
     int width,
     int height)
     : global_composite_operation(source_over)
+    , antialiasing(true)
+    , fixed_point_coverage(false)
     , shadow_offset_x(0.0f)
     , shadow_offset_y(0.0f)
     , line_cap(butt)
@@ -2795,6 +3506,7 @@ canvas::canvas(
     , line_dash_offset(0.0f)
     , text_align(start)
     , text_baseline(alphabetic)
+    , image_filter(bicubic)
     , size_x(width)
     , size_y(height)
     , global_alpha(1.0f)
@@ -2805,7 +3517,8 @@ canvas::canvas(
     , stroke_brush()
     , image_brush()
     , face()
-    , bitmap(new rgba[width * height])
+    , layout()
+    , bitmap(static_cast<size_t>(width * height))
     , saves(0)
 {
     affine_matrix identity = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
@@ -2821,11 +3534,12 @@ canvas::canvas(
         mask.push_back(piece_1);
         mask.push_back(piece_2);
     }
+    index_rows(mask, mask_rows, size_y);
+    mask_maximum = xy(static_cast<float>(size_x), static_cast<float>(size_y));
 }
 
 canvas::~canvas()
 {
-    delete[] bitmap;
     while (canvas *head = saves)
     {
         saves = head->saves;
@@ -3043,10 +3757,8 @@ void canvas::set_pattern(
         for (int x = 0; x < width; ++x)
         {
             int index = y * stride + x * 4;
-            rgba color = rgba(
-                image[index + 0] / 255.0f, image[index + 1] / 255.0f,
-                image[index + 2] / 255.0f, image[index + 3] / 255.0f);
-            brush.colors.push_back(premultiplied(linearized(color)));
+            brush.colors.push_back(
+                premultiplied(linearized(image + index)));
         }
     brush.width = width;
     brush.height = height;
@@ -3258,6 +3970,9 @@ void canvas::clip()
     float sum_2 = 0.0f;
     size_t index_1 = 0;
     size_t index_2 = part;
+    if (part)
+        index_2 += mask_rows[std::min(static_cast<size_t>(runs.front().y),
+                                      mask_rows.size() - 1)];
     while (index_1 < part && index_2 < runs.size())
     {
         bool which = runs[index_1] < runs[index_2];
@@ -3287,6 +4002,18 @@ void canvas::clip()
         }
         last = visibility;
     }
+    index_rows(mask, mask_rows, size_y);
+    mask_minimum = xy(static_cast<float>(size_x), static_cast<float>(size_y));
+    mask_maximum = xy(0.0f, 0.0f);
+    for (size_t index = 0; index < mask.size(); ++index)
+    {
+        xy corner = xy(static_cast<float>(mask[index].x),
+                       static_cast<float>(mask[index].y));
+        mask_minimum = xy(std::min(mask_minimum.x, corner.x),
+                          std::min(mask_minimum.y, corner.y));
+        mask_maximum = xy(std::max(mask_maximum.x, corner.x),
+                          std::max(mask_maximum.y, corner.y + 1.0f));
+    }
 }
 
 bool canvas::is_point_in_path(
@@ -3401,6 +4128,8 @@ bool canvas::set_font(
     if (font && bytes)
     {
         face.data.clear();
+        face.latin.clear();
+        face.ranges.clear();
         face.cmap = 0;
         face.glyf = 0;
         face.head = 0;
@@ -3456,6 +4185,7 @@ bool canvas::set_font(
             face.data.clear();
             return false;
         }
+        build_glyph_map();
     }
     if (face.data.empty())
         return false;
@@ -3470,7 +4200,8 @@ void canvas::fill_text(
     float y,
     float maximum_width)
 {
-    text_to_lines(text, xy(x, y), maximum_width, false);
+    layout_text(text, layout);
+    text_to_lines(layout, xy(x, y), maximum_width, false);
     render_main(fill_brush);
 }
 
@@ -3480,7 +4211,8 @@ void canvas::stroke_text(
     float y,
     float maximum_width)
 {
-    text_to_lines(text, xy(x, y), maximum_width, true);
+    layout_text(text, layout);
+    text_to_lines(layout, xy(x, y), maximum_width, true);
     stroke_lines();
     render_main(stroke_brush);
 }
@@ -3501,6 +4233,47 @@ float canvas::measure_text(
     return static_cast<float>(width) * face.scale;
 }
 
+void canvas::layout_text(
+    char const *text,
+    text_layout &layout)
+{
+    layout.glyphs.clear();
+    layout.positions.clear();
+    layout.width = 0;
+    if (face.data.empty() || !text)
+        return;
+    int hmetrics = unsigned_16(face.data, face.hhea + 34);
+    for (int index = 0; text[index];)
+    {
+        int glyph = character_to_glyph(text, index);
+        layout.glyphs.push_back(glyph);
+        layout.positions.push_back(layout.width);
+        int entry = std::min(glyph, hmetrics - 1);
+        layout.width += unsigned_16(face.data, face.hmtx + entry * 4);
+    }
+}
+
+void canvas::fill_glyphs(
+    text_layout const &layout,
+    float x,
+    float y,
+    float maximum_width)
+{
+    text_to_lines(layout, xy(x, y), maximum_width, false);
+    render_main(fill_brush);
+}
+
+void canvas::stroke_glyphs(
+    text_layout const &layout,
+    float x,
+    float y,
+    float maximum_width)
+{
+    text_to_lines(layout, xy(x, y), maximum_width, true);
+    stroke_lines();
+    render_main(stroke_brush);
+}
+
 void canvas::draw_image(
     unsigned char const *image,
     int width,
@@ -3536,6 +4309,46 @@ void canvas::draw_image(
     inverse = saved_inverse;
 }
 
+void canvas::draw_layer(
+    canvas &layer,
+    float x,
+    float y)
+{
+    if (&layer == this || layer.size_x <= 0 || layer.size_y <= 0 ||
+        forward.a * forward.d - forward.b * forward.c == 0.0f)
+        return;
+    // Borrow the layer's pixels as the brush's; the guard hands them back
+    // on the way out, even if rendering throws (e.g., std::bad_alloc).
+    struct borrow
+    {
+        std::vector<rgba> &owner;
+        std::vector<rgba> &borrower;
+        borrow(std::vector<rgba> &from, std::vector<rgba> &to)
+            : owner(from), borrower(to) { borrower.swap(owner); }
+        ~borrow() { borrower.swap(owner); }
+    } borrowed(layer.bitmap, image_brush.colors);
+    image_brush.type = paint_brush::pattern;
+    image_brush.width = layer.size_x;
+    image_brush.height = layer.size_y;
+    image_brush.repetition = repeat;
+    float width = static_cast<float>(layer.size_x);
+    float height = static_cast<float>(layer.size_y);
+    lines.points.clear();
+    lines.subpaths.clear();
+    lines.points.push_back(forward * xy(x, y));
+    lines.points.push_back(forward * xy(x + width, y));
+    lines.points.push_back(forward * xy(x + width, y + height));
+    lines.points.push_back(forward * xy(x, y + height));
+    subpath_data entry = {4, true};
+    lines.subpaths.push_back(entry);
+    affine_matrix saved_forward = forward;
+    affine_matrix saved_inverse = inverse;
+    translate(x, y);
+    render_main(image_brush);
+    forward = saved_forward;
+    inverse = saved_inverse;
+}
+
 void canvas::get_image_data(
     unsigned char *image,
     int width,
@@ -3617,11 +4430,8 @@ void canvas::put_image_data(
             if (canvas_x < 0 || size_x <= canvas_x ||
                 canvas_y < 0 || size_y <= canvas_y)
                 continue;
-            rgba color = rgba(
-                image[index + 0] / 255.0f, image[index + 1] / 255.0f,
-                image[index + 2] / 255.0f, image[index + 3] / 255.0f);
             bitmap[canvas_y * size_x + canvas_x] =
-                premultiplied(linearized(color));
+                premultiplied(linearized(image + index));
         }
 }
 
@@ -3629,6 +4439,8 @@ void canvas::save()
 {
     canvas *state = new canvas(0, 0);
     state->global_composite_operation = global_composite_operation;
+    state->antialiasing = antialiasing;
+    state->fixed_point_coverage = fixed_point_coverage;
     state->shadow_offset_x = shadow_offset_x;
     state->shadow_offset_y = shadow_offset_y;
     state->line_cap = line_cap;
@@ -3636,6 +4448,7 @@ void canvas::save()
     state->line_dash_offset = line_dash_offset;
     state->text_align = text_align;
     state->text_baseline = text_baseline;
+    state->image_filter = image_filter;
     state->forward = forward;
     state->inverse = inverse;
     state->global_alpha = global_alpha;
@@ -3647,6 +4460,9 @@ void canvas::save()
     state->fill_brush = fill_brush;
     state->stroke_brush = stroke_brush;
     state->mask = mask;
+    state->mask_rows = mask_rows;
+    state->mask_minimum = mask_minimum;
+    state->mask_maximum = mask_maximum;
     state->face = face;
     state->saves = saves;
     saves = state;
@@ -3658,6 +4474,8 @@ void canvas::restore()
         return;
     canvas *state = saves;
     global_composite_operation = state->global_composite_operation;
+    antialiasing = state->antialiasing;
+    fixed_point_coverage = state->fixed_point_coverage;
     shadow_offset_x = state->shadow_offset_x;
     shadow_offset_y = state->shadow_offset_y;
     line_cap = state->line_cap;
@@ -3665,6 +4483,7 @@ void canvas::restore()
     line_dash_offset = state->line_dash_offset;
     text_align = state->text_align;
     text_baseline = state->text_baseline;
+    image_filter = state->image_filter;
     forward = state->forward;
     inverse = state->inverse;
     global_alpha = state->global_alpha;
@@ -3676,6 +4495,9 @@ void canvas::restore()
     fill_brush = state->fill_brush;
     stroke_brush = state->stroke_brush;
     mask = state->mask;
+    mask_rows = state->mask_rows;
+    mask_minimum = state->mask_minimum;
+    mask_maximum = state->mask_maximum;
     face = state->face;
     saves = state->saves;
     state->saves = 0;
@@ -0,0 +1,80 @@
+#include "compositor.h"
+
+// Local dependencies
+#include "magic.h"
+#include "simd.h"
+
+// Global
+#include <stdlib.h>
+
+void blend_rgb565(uint16_t *dst, const uint16_t *a, const uint16_t *b, int count, int mix)
+{
+    const uint16_t mb = (uint16_t)mix;
+    const uint16_t ma = (uint16_t)(mix_one - mix);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        u16x8 pa = vload<u16x8>(a + i);
+        u16x8 pb = vload<u16x8>(b + i);
+        u16x8 r = ((pa >> 11) * ma + (pb >> 11) * mb) >> 8;
+        u16x8 g = (((pa >> 5) & 63) * ma + ((pb >> 5) & 63) * mb) >> 8;
+        u16x8 bl = ((pa & 31) * ma + (pb & 31) * mb) >> 8;
+        vstore(dst + i, (r << 11) | (g << 5) | bl);
+    }
+    for (; i < count; ++i)
+    {
+        int r = ((a[i] >> 11) * ma + (b[i] >> 11) * mb) >> 8;
+        int g = (((a[i] >> 5) & 63) * ma + ((b[i] >> 5) & 63) * mb) >> 8;
+        int bl = ((a[i] & 31) * ma + (b[i] & 31) * mb) >> 8;
+        dst[i] = (uint16_t)((r << 11) | (g << 5) | bl);
+    }
+}
+
+void blend_rgba8(uint8_t *dst, const uint8_t *a, const uint8_t *b, int count, int mix)
+{
+    const uint16_t mb = (uint16_t)mix;
+    const uint16_t ma = (uint16_t)(mix_one - mix);
+    int n = count * 4;
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        u16x8 pa = __builtin_convertvector(vload<u8x8>(a + i), u16x8);
+        u16x8 pb = __builtin_convertvector(vload<u8x8>(b + i), u16x8);
+        u16x8 res = (pa * ma + pb * mb) >> 8;
+        vstore(dst + i, __builtin_convertvector(res, u8x8));
+    }
+    for (; i < n; ++i)
+        dst[i] = (uint8_t)((a[i] * ma + b[i] * mb) >> 8);
+}
+
+const uint16_t *Compositor::compose(const uint16_t *a, const uint16_t *b, int mix)
+{
+    if (mix <= 0) return a;
+    if (mix >= mix_one) return b;
+    out_rgb565.resize(W * H);
+    blend_rgb565(&out_rgb565[0], a, b, W * H, mix);
+    return &out_rgb565[0];
+}
+
+const uint8_t *Compositor::compose(const uint8_t *a, const uint8_t *b, int mix)
+{
+    if (mix <= 0) return a;
+    if (mix >= mix_one) return b;
+    out_rgba8.resize(W * H * 4);
+    blend_rgba8(&out_rgba8[0], a, b, W * H, mix);
+    return &out_rgba8[0];
+}
+
+int Compositor::mix_for(const TuneResult &tune)
+{
+    if (tune.state == tune_on) return mix_one;
+    if (tune.state == tune_static) return 0;
+
+    // Near station: fade in from the overlay edge to the lock edge, eased with smoothstep
+    const Station &st = *tune.station;
+    float t = (float)(st.overlay_width - abs(tune.detune)) / (st.overlay_width - st.lock_width);
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    t = t * t * (3 - 2 * t);
+    return (int)(t * mix_one);
+}
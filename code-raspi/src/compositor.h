@@ -0,0 +1,30 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include "station_registry.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Mix factors are fixed-point: 0 is all of the first source, mix_one all of the second
+static const int mix_one = 256;
+
+void blend_rgb565(uint16_t *dst, const uint16_t *a, const uint16_t *b, int count, int mix);
+void blend_rgba8(uint8_t *dst, const uint8_t *a, const uint8_t *b, int count, int mix);
+
+// Crossfades between static and a station's frame. When the mix is exactly
+// 0 or mix_one, the matching source is returned as is and nothing is blended.
+class Compositor
+{
+  private:
+    std::vector<uint16_t> out_rgb565;
+    std::vector<uint8_t> out_rgba8;
+
+  public:
+    const uint16_t *compose(const uint16_t *a, const uint16_t *b, int mix);
+    const uint8_t *compose(const uint8_t *a, const uint8_t *b, int mix);
+
+    static int mix_for(const TuneResult &tune);
+};
+
+#endif
@@ -21,7 +21,7 @@ class igr_exception : public std::runtime_error
     }
 };
 
-void throwf(const char *fmt, ...);
-void throwf_errno(const char *fmt, ...);
+[[noreturn]] void throwf(const char *fmt, ...);
+[[noreturn]] void throwf_errno(const char *fmt, ...);
 
 #endif
@@ -93,15 +93,18 @@ uint8_t *load_file(const char *path, size_t *size_out)
     return buf;
 }
 
-uint8_t *load_canvas_font(size_t *data_size)
+std::string get_bin_path(const char *file_name)
 {
-    readlink("/proc/self/exe", buf, buf_sz - 1);
-    dirname(buf);
-    std::string bin_dir(buf);
-
-    std::string font_path(bin_dir);
-    font_path += "/";
-    font_path += font_file_name;
+    ssize_t len = readlink("/proc/self/exe", buf, buf_sz - 1);
+    buf[len < 0 ? 0 : len] = 0;
+    std::string path(dirname(buf));
+    path += "/";
+    path += file_name;
+    return path;
+}
 
+uint8_t *load_canvas_font(size_t *data_size)
+{
+    std::string font_path = get_bin_path(font_file_name);
     return load_file(font_path.c_str(), data_size);
 }
@@ -3,8 +3,10 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string>
 
 void flush_to_fb(float *image);
+std::string get_bin_path(const char *file_name);
 uint8_t *load_file(const char *path, size_t *size_out);
 uint8_t *load_canvas_font(size_t *data_size);
 
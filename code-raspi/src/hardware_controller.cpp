@@ -5,10 +5,12 @@
 #include "magic.h"
 
 // Global
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/i2c-dev.h>
 #include <math.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -18,24 +20,41 @@ uint8_t HardwareController::buffer[buf_sz] = {0};
 int HardwareController::file_i2c = -1;
 pthread_t HardwareController::thread;
 pthread_mutex_t HardwareController::mut;
-std::vector<uint8_t> HardwareController::commands;
+std::vector<std::vector<uint8_t>> HardwareController::commands;
 bool HardwareController::quitting = false;
+AttentionSource *HardwareController::attention = nullptr;
+int HardwareController::wake_fds[2] = {-1, -1};
 int HardwareController::val_tuner;
+int HardwareController::val_tuner_fine;
+int HardwareController::val_tuner_velocity;
 int HardwareController::val_aknob;
 int HardwareController::val_bknob;
 int HardwareController::val_cknob;
 int HardwareController::val_swtch;
-
-#pragma pack(push, 1)
-struct InputReadings
+int HardwareController::val_cknob_level;
+bool HardwareController::val_switch_on = false;
+uint16_t HardwareController::capabilities = 0;
+float HardwareController::burst_period = 0;
+bool HardwareController::use_attention = false;
+bool HardwareController::have_sample = false;
+uint16_t HardwareController::last_seq = 0;
+uint32_t HardwareController::last_sample_time = 0;
+bool HardwareController::have_burst = false;
+uint16_t HardwareController::last_burst_seq = 0;
+OneEuroFilter HardwareController::filt_tuner(FILTER_TUNER);
+OneEuroFilter HardwareController::filt_aknob(FILTER_KNOB);
+OneEuroFilter HardwareController::filt_bknob(FILTER_KNOB);
+OneEuroFilter HardwareController::filt_cknob(FILTER_KNOB);
+HysteresisQuantizer HardwareController::quant_cknob(CKNOB_LEVELS, 0, ADC_MAX + 1, CKNOB_HYSTERESIS);
+
+// Order of channels in BurstReadings
+enum BurstChannelIx
 {
-    uint16_t tuner;
-    uint16_t aKnob;
-    uint16_t bKnob;
-    uint16_t cKnob;
-    uint8_t swtch;
+    burst_aknob = 0,
+    burst_bknob = 1,
+    burst_cknob = 2,
+    burst_tuner = 3,
 };
-#pragma pack(pop)
 
 struct Lock
 {
@@ -53,6 +72,22 @@ struct Lock
 
 void HardwareController::init()
 {
+    // Attention line only if one is configured and its GPIO is available; polling otherwise
+    AttentionSource *source = nullptr;
+    if (ATTN_GPIO_LINE >= 0)
+    {
+        try
+        {
+            source = new GpioAttention(ATTN_GPIO_CHIP, ATTN_GPIO_LINE);
+        }
+        catch (const igr_exception &e)
+        {
+            printf("No attention line, polling MCU instead: %s\n", e.what());
+        }
+    }
+    if (source == nullptr) source = new PollingAttention();
+    attention = source;
+
     // Open I2C bus
     char *filename = (char *)I2C_NODE;
     if ((file_i2c = open(filename, O_RDWR)) < 0)
@@ -76,6 +111,15 @@ void HardwareController::init()
         throwf("Failed to initialize mutex: %d: %s", r, strerror(r));
     }
 
+    // Lets queued commands and exit() interrupt the wait for attention
+    if (pipe(wake_fds) != 0)
+    {
+        deinit();
+        throwf_errno("Failed to create pipe");
+    }
+    fcntl(wake_fds[0], F_SETFL, fcntl(wake_fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wake_fds[1], F_SETFL, fcntl(wake_fds[1], F_GETFL) | O_NONBLOCK);
+
     // Start worker thread
     r = pthread_create(&thread, NULL, loop, NULL);
     if (r != 0)
@@ -92,6 +136,11 @@ void HardwareController::deinit()
     {
         if (file_i2c != -1) close(file_i2c);
         file_i2c = -1;
+        if (wake_fds[0] != -1) close(wake_fds[0]);
+        if (wake_fds[1] != -1) close(wake_fds[1]);
+        wake_fds[0] = wake_fds[1] = -1;
+        delete attention;
+        attention = nullptr;
     }
     catch (...)
     {
@@ -100,90 +149,296 @@ void HardwareController::deinit()
 
 void HardwareController::exit()
 {
+    if (use_attention) push_command(CMD_ATTN_OFF);
     quitting = true;
 }
 
 void *HardwareController::loop(void *)
 {
     bool last_cycle_failed = false;
-    InputReadings data;
-    int length = (int)sizeof(InputReadings);
+    Frame<InputReadingsEx> data;
+    Frame<BurstReadings> burst;
+    InputReadings legacy_data;
 
-    // Sanity check to keep things in sync with MCU code
-    if (length != 9)
-    {
-        fprintf(stderr, "Program error; giving up. Wrong size of InputReadings: %lu", sizeof(InputReadings));
-        return nullptr;
-    }
+    if (!negotiate(NEGOTIATE_ATTEMPTS, false)) printf("MCU doesn't answer hello; using legacy protocol\n");
+    int legacy_cycles = 0;
+    int failures = 0;
 
     while (!quitting)
     {
-        usleep(HWCTRL_CYCLE_MSEC * 1000);
+        wait_for_attention();
+
+        // Decision isn't final: MCU may boot late, or reset, maybe into other firmware
+        if (capabilities == 0 ? ++legacy_cycles * HWCTRL_CYCLE_MSEC >= NEGOTIATE_RETRY_MSEC
+                              : failures >= NEGOTIATE_AFTER_FAILURES)
+        {
+            legacy_cycles = 0;
+            failures = 0;
+            bool was_framed = capabilities != 0;
+            if (!negotiate(1, true) && was_framed) printf("MCU stopped answering hello; using legacy protocol\n");
+        }
 
-        // Send commands from queue
+        // Send commands from queue, each in its own write
         while (true)
         {
-            uint8_t cmd = 0xff;
+            std::vector<uint8_t> cmd;
             {
                 Lock lock(&mut);
                 if (commands.size() > 0)
                 {
-                    cmd = commands.front();
+                    cmd.swap(commands.front());
                     commands.erase(commands.begin());
                 }
             }
-            if (cmd == 0xff) break;
-            buffer[0] = cmd;
-            if (write(file_i2c, buffer, 1) != 1)
+            if (cmd.empty()) break;
+            // Older firmware would take the arguments for commands of their own
+            if (cmd[0] == CMD_HAPTIC && !(capabilities & CAP_HAPTIC)) continue;
+            if (cmd[0] == CMD_LIGHT_BREATHE && !(capabilities & CAP_LIGHT_FADE)) continue;
+            if (cmd[0] == CMD_LIGHT_FADE && !(capabilities & CAP_LIGHT_FADE))
+            {
+                // Light that can only be switched jumps straight to the target
+                LightFade fade;
+                memcpy(&fade, &cmd[1], sizeof(fade));
+                cmd.assign(1, fade.level >= 128 ? CMD_LIGHT_ON : CMD_LIGHT_OFF);
+            }
+            if (write(file_i2c, cmd.data(), cmd.size()) != (ssize_t)cmd.size())
             {
                 printf("Failed to write command to the I2C bus; it's lost now: %d: %s\n", errno, strerror(errno));
             }
         }
 
-        // Send command 0x00 to read values
-        buffer[0] = 0x00;
-        if (write(file_i2c, buffer, 1) != 1)
+        // Values with sequence number and timestamp; plain readings from older firmware
+        if (capabilities & CAP_READINGS_EX)
         {
-            if (!last_cycle_failed)
-                printf("Failed to write 0x00 to the I2C bus: %d: %s\n", errno, strerror(errno));
-            last_cycle_failed = true;
-            continue;
+            if (!query_frame(CMD_READINGS_EX, data, last_cycle_failed))
+            {
+                ++failures;
+                continue;
+            }
+            failures = 0;
+            process_values(data.payload);
         }
-        else if (last_cycle_failed)
+        else
         {
-            printf("Successful write to I2C bus after one or more failures.\n");
-            last_cycle_failed = false;
+            if (!query(CMD_READINGS, &legacy_data, sizeof(InputReadings), last_cycle_failed)) continue;
+            process_legacy_values(legacy_data);
         }
 
-        // Read control values
-        if (read(file_i2c, &data, length) != length)
+        // Recent history of analog inputs
+        if (capabilities & CAP_BURST)
         {
-            if (!last_cycle_failed)
-                fprintf(stderr, "Failed to read from the I2C bus: %d: %s\n", errno, strerror(errno));
-            last_cycle_failed = true;
-            continue;
+            if (!query_frame(CMD_BURST, burst, last_cycle_failed))
+            {
+                ++failures;
+                continue;
+            }
+            process_burst(burst.payload);
         }
-        else if (last_cycle_failed)
+    }
+
+    deinit();
+    return nullptr;
+}
+
+bool HardwareController::negotiate(int attempts, bool quiet)
+{
+    // Firmware from before the framed protocol doesn't know CMD_HELLO; its reply fails the CRC
+    Frame<HelloReply> hello;
+    bool failed = false;
+    // Sequence numbers and timestamps start over if the MCU reset
+    have_sample = false;
+    have_burst = false;
+    for (int i = 0; i < attempts && !quitting; ++i)
+    {
+        if (i > 0) usleep(HWCTRL_CYCLE_MSEC * 1000);
+        if (!query_frame(CMD_HELLO, hello, failed, quiet)) continue;
+
+        capabilities = hello.payload.capabilities;
+        burst_period = hello.payload.burstPeriod * 1e-6f;
+        printf("MCU protocol version %d, capabilities 0x%04x\n", hello.version, capabilities);
+
+        // MCU only drives the attention line when asked to
+        use_attention = attention->get_fd() != -1 && (capabilities & CAP_ATTENTION) != 0;
+        if (use_attention) push_command(CMD_ATTN_ON);
+        return true;
+    }
+    capabilities = 0;
+    use_attention = false;
+    return false;
+}
+
+void HardwareController::wait_for_attention()
+{
+    int attn_fd = attention->get_fd();
+    if (!use_attention)
+    {
+        usleep(HWCTRL_CYCLE_MSEC * 1000);
+        return;
+    }
+
+    // Rate limit while inputs keep changing
+    usleep(ATTN_MIN_INTERVAL_MSEC * 1000);
+
+    // Timeout makes up for an edge that happened before we were listening
+    struct pollfd fds[2];
+    fds[0].fd = attn_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fds[0];
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, ATTN_TIMEOUT_MSEC) < 0)
+    {
+        if (errno != EINTR) printf("Failed to wait for attention: %d: %s\n", errno, strerror(errno));
+        return;
+    }
+    if (fds[0].revents & POLLIN) attention->clear();
+    if (fds[1].revents & POLLIN)
+    {
+        char buf[16];
+        while (read(wake_fds[0], buf, sizeof(buf)) > 0)
         {
-            printf("Successful read from I2C bus after one or more failures.\n");
-            last_cycle_failed = false;
         }
+    }
+}
 
-        // Smooth and store in thread-safe way
-        process_values(data);
+bool HardwareController::query(uint8_t cmd, void *reply, int length, bool &last_cycle_failed, bool quiet)
+{
+    buffer[0] = cmd;
+    if (write(file_i2c, buffer, 1) != 1)
+    {
+        if (!last_cycle_failed && !quiet)
+            printf("Failed to write 0x%02x to the I2C bus: %d: %s\n", cmd, errno, strerror(errno));
+        last_cycle_failed = true;
+        return false;
+    }
+    else if (last_cycle_failed)
+    {
+        if (!quiet) printf("Successful write to I2C bus after one or more failures.\n");
+        last_cycle_failed = false;
     }
 
-    deinit();
-    return nullptr;
+    if (read(file_i2c, reply, length) != length)
+    {
+        if (!last_cycle_failed && !quiet)
+            fprintf(stderr, "Failed to read from the I2C bus: %d: %s\n", errno, strerror(errno));
+        last_cycle_failed = true;
+        return false;
+    }
+    else if (last_cycle_failed)
+    {
+        if (!quiet) printf("Successful read from I2C bus after one or more failures.\n");
+        last_cycle_failed = false;
+    }
+    return true;
+}
+
+template <typename T>
+bool HardwareController::query_frame(uint8_t cmd, Frame<T> &frame, bool &last_cycle_failed, bool quiet)
+{
+    if (!query(cmd, &frame, sizeof(Frame<T>), last_cycle_failed, quiet)) return false;
+    if (frameValid(frame)) return true;
+
+    // Corrupt or from another protocol version: treat like a failed read
+    if (!last_cycle_failed && !quiet)
+        fprintf(stderr, "Discarding invalid reply to 0x%02x: version %d, CRC 0x%02x\n", cmd, frame.version, frame.crc);
+    last_cycle_failed = true;
+    return false;
 }
 
-void HardwareController::process_values(const InputReadings &data)
+void HardwareController::process_values(const InputReadingsEx &data_ex)
 {
-    __atomic_store_n(&val_tuner, (int)data.tuner, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&val_aknob, (int)data.aKnob, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&val_bknob, (int)data.bKnob, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&val_cknob, (int)data.cKnob, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&val_swtch, (int)data.swtch, __ATOMIC_SEQ_CST);
+    // Same snapshot as last time: MCU has no new samples
+    if (have_sample && data_ex.seq == last_seq) return;
+    bool first = !have_sample;
+    // Each snapshot spans several samples, so time comes from the timestamps, not from seq
+    uint32_t elapsed_usec = data_ex.sampleTime - last_sample_time;
+    have_sample = true;
+    last_seq = data_ex.seq;
+    last_sample_time = data_ex.sampleTime;
+
+    __atomic_store_n(&val_swtch, (int)data_ex.swtchTicks, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_switch_on, data_ex.swtchTicks < SWITCH_THRESHOLD_TICKS, __ATOMIC_SEQ_CST);
+
+    // Analog inputs come from the burst if MCU has it
+    if (capabilities & CAP_BURST) return;
+    const InputReadings &data = data_ex.readings;
+    float dt = first ? 0 : elapsed_usec * 1e-6f;
+    filter_sample(data_ex.tunerFine, data.aKnob, data.bKnob, data.cKnob, dt);
+    store_analog();
+}
+
+void HardwareController::process_legacy_values(const InputReadings &data)
+{
+    // No timing info: assume one fresh sample per cycle
+    int swtch_ticks = data.swtch * SWITCH_LEGACY_TICKS_PER_STEP;
+    __atomic_store_n(&val_swtch, swtch_ticks, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_switch_on, swtch_ticks < SWITCH_THRESHOLD_TICKS, __ATOMIC_SEQ_CST);
+    filter_sample(data.tuner * TUNER_FINE_SCALE, data.aKnob, data.bKnob, data.cKnob, HWCTRL_CYCLE_MSEC * 1e-3f);
+    store_analog();
+}
+
+void HardwareController::process_burst(const BurstReadings &burst)
+{
+    // Number of samples since last burst; on the first one, only the newest sample is trusted
+    int n_new = have_burst ? (uint16_t)(burst.seq - last_burst_seq) : 1;
+    if (n_new == 0) return;
+    // Gap longer than the burst: first sample we have bridges the missing ones
+    int n_missed = 0;
+    if (n_new > BURST_LENGTH)
+    {
+        n_missed = n_new - BURST_LENGTH;
+        n_new = BURST_LENGTH;
+    }
+    have_burst = true;
+    last_burst_seq = burst.seq;
+
+    // Decode deltas
+    int vals[4][BURST_LENGTH];
+    for (int ch = 0; ch < 4; ++ch)
+    {
+        vals[ch][0] = burst.channels[ch].first;
+        for (int i = 1; i < BURST_LENGTH; ++i)
+            vals[ch][i] = vals[ch][i - 1] + burst.channels[ch].deltas[i - 1];
+    }
+
+    // Feed each new sample to the filters at the MCU's sample spacing
+    for (int i = BURST_LENGTH - n_new; i < BURST_LENGTH; ++i)
+    {
+        float dt = burst_period;
+        if (i == BURST_LENGTH - n_new) dt *= 1 + n_missed;
+        filter_sample(vals[burst_tuner][i], vals[burst_aknob][i], vals[burst_bknob][i], vals[burst_cknob][i], dt);
+    }
+    store_analog();
+}
+
+void HardwareController::filter_sample(int tuner_fine, int aknob, int bknob, int cknob, float dt)
+{
+    // Tuner is filtered at full resolution, but in units of the plain reading
+    filt_tuner.filter(tuner_fine / (float)TUNER_FINE_SCALE, dt);
+    filt_aknob.filter(aknob, dt);
+    filt_bknob.filter(bknob, dt);
+    filt_cknob.filter(cknob, dt);
+}
+
+void HardwareController::store_analog()
+{
+    float tuner = filt_tuner.value();
+    float aknob = filt_aknob.value();
+    float bknob = filt_bknob.value();
+    float cknob = filt_cknob.value();
+    int cknob_level = quant_cknob.quantize(cknob);
+    float tuner_velocity = filt_tuner.derivative() * TUNER_FINE_SCALE;
+
+    // Filter can overshoot full scale; calibration tables are indexed by these
+    int tuner_val = std::min(std::max((int)roundf(tuner), 0), ADC_MAX);
+    int tuner_fine = std::min(std::max((int)roundf(tuner * TUNER_FINE_SCALE), 0), ADC_MAX * TUNER_FINE_SCALE);
+
+    __atomic_store_n(&val_tuner, tuner_val, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_tuner_fine, tuner_fine, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_tuner_velocity, (int)roundf(tuner_velocity), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_aknob, (int)roundf(aknob), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_bknob, (int)roundf(bknob), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_cknob, (int)roundf(cknob), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&val_cknob_level, cknob_level, __ATOMIC_SEQ_CST);
 }
 
 void HardwareController::get_values(int &tuner, int &aknob, int &bknob, int &cknob, int &swtch)
@@ -195,53 +450,69 @@ void HardwareController::get_values(int &tuner, int &aknob, int &bknob, int &ckn
     swtch = __atomic_load_n(&val_swtch, __ATOMIC_SEQ_CST);
 }
 
-void HardwareController::set_light(bool on)
+int HardwareController::get_tuner_fine()
 {
-    uint8_t cmd = on ? 0x11 : 0x10;
-    Lock lock(&mut);
-    commands.push_back(cmd);
+    return __atomic_load_n(&val_tuner_fine, __ATOMIC_SEQ_CST);
 }
 
-int tuner_val_to_freq(int val)
+int HardwareController::get_tuner_velocity()
 {
-    // Know values for Lagrange interpolation:
-    // 144 =>  90 MHz
-    // 473 =>  98 MHz
-    // 703 => 102 MHz
-
-    const double x1 = 144, y1 = 90;
-    const double x2 = 473, y2 = 98;
-    const double x3 = 703, y3 = 102;
-
-    double x = val;
+    return __atomic_load_n(&val_tuner_velocity, __ATOMIC_SEQ_CST);
+}
 
-    // clang-format off
-    double freq = y1 * ((x - x2)*(x - x3)) / ((x1 - x2)*(x1 - x3))
-                + y2 * ((x - x1)*(x - x3)) / ((x2 - x1)*(x2 - x3))
-                + y3 * ((x - x1)*(x - x2)) / ((x3 - x1)*(x3 - x2));
-    // clang-format on
+int HardwareController::get_cknob_level()
+{
+    return __atomic_load_n(&val_cknob_level, __ATOMIC_SEQ_CST);
+}
 
-    return (int)round(freq * 10);
+bool HardwareController::get_switch_on()
+{
+    return __atomic_load_n(&val_switch_on, __ATOMIC_SEQ_CST);
 }
 
-int freq_to_tuner_val(int freq)
+void HardwareController::set_light(bool on)
 {
-    // Know values for Lagrange interpolation:
-    // 144 =>  90 MHz
-    // 473 =>  98 MHz
-    // 703 => 102 MHz
+    push_command(on ? CMD_LIGHT_ON : CMD_LIGHT_OFF);
+}
 
-    const double y1 = 144, x1 = 90;
-    const double y2 = 473, x2 = 98;
-    const double y3 = 703, x3 = 102;
+void HardwareController::fade_light(int level, int duration_msec)
+{
+    LightFade fade;
+    fade.level = level;
+    fade.duration = duration_msec;
+    push_command(CMD_LIGHT_FADE, &fade, sizeof(fade));
+}
 
-    double x = freq;
+void HardwareController::breathe_light(int low, int high, int period_msec)
+{
+    LightBreathe breathe;
+    breathe.low = low;
+    breathe.high = high;
+    breathe.period = period_msec;
+    push_command(CMD_LIGHT_BREATHE, &breathe, sizeof(breathe));
+}
 
-    // clang-format off
-    double val  = y1 * ((x - x2)*(x - x3)) / ((x1 - x2)*(x1 - x3))
-                + y2 * ((x - x1)*(x - x3)) / ((x2 - x1)*(x2 - x3))
-                + y3 * ((x - x1)*(x - x2)) / ((x3 - x1)*(x3 - x2));
-    // clang-format on
+void HardwareController::play_haptic(int intensity, int attack_msec, int sustain_msec, int decay_msec)
+{
+    HapticEnvelope env;
+    env.intensity = intensity;
+    env.attack = attack_msec;
+    env.sustain = sustain_msec;
+    env.decay = decay_msec;
+    push_command(CMD_HAPTIC, &env, sizeof(env));
+}
 
-    return (int)round(val * 10);
+void HardwareController::push_command(uint8_t cmd, const void *args, size_t args_size)
+{
+    std::vector<uint8_t> bytes(1 + args_size);
+    bytes[0] = cmd;
+    if (args_size > 0) memcpy(&bytes[1], args, args_size);
+    {
+        Lock lock(&mut);
+        commands.push_back(bytes);
+    }
+    // Full pipe means worker is already due to wake up
+    char b = 1;
+    if (wake_fds[1] != -1 && write(wake_fds[1], &b, 1) != 1 && errno != EAGAIN)
+        printf("Failed to wake hardware thread: %d: %s\n", errno, strerror(errno));
 }
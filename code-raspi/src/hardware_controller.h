@@ -1,12 +1,14 @@
 #ifndef HARDWARE_CONTROLLER_H
 #define HARDWARE_CONTROLLER_H
 
+#include "attention.h"
+#include "protocol.h"
+#include "signal_filter.h"
+
 #include <pthread.h>
 #include <stdint.h>
 #include <vector>
 
-struct InputReadings;
-
 class HardwareController
 {
   private:
@@ -15,27 +17,65 @@ class HardwareController
     static int file_i2c;
     static pthread_t thread;
     static pthread_mutex_t mut;
-    static std::vector<uint8_t> commands;
+    static std::vector<std::vector<uint8_t>> commands;
     static bool quitting;
+    static AttentionSource *attention;
+    static int wake_fds[2];
     static int val_tuner;
+    static int val_tuner_fine;
+    static int val_tuner_velocity;
     static int val_aknob;
     static int val_bknob;
     static int val_cknob;
     static int val_swtch;
+    static int val_cknob_level;
+    static bool val_switch_on;
+    static uint16_t capabilities;
+    static float burst_period;
+    static bool use_attention;
+    static bool have_sample;
+    static uint16_t last_seq;
+    static uint32_t last_sample_time;
+    static bool have_burst;
+    static uint16_t last_burst_seq;
+    static OneEuroFilter filt_tuner;
+    static OneEuroFilter filt_aknob;
+    static OneEuroFilter filt_bknob;
+    static OneEuroFilter filt_cknob;
+    static HysteresisQuantizer quant_cknob;
 
   private:
     static void *loop(void *);
     static void deinit();
-    static void process_values(const InputReadings &data);
+    // Asks for the MCU's capabilities; false if it doesn't answer, leaving legacy protocol
+    static bool negotiate(int attempts, bool quiet);
+    static void wait_for_attention();
+    static void push_command(uint8_t cmd, const void *args = nullptr, size_t args_size = 0);
+    // Quiet queries don't report failures, for ones that are expected to fail again and again
+    static bool query(uint8_t cmd, void *reply, int length, bool &last_cycle_failed, bool quiet = false);
+    template <typename T>
+    static bool query_frame(uint8_t cmd, Frame<T> &frame, bool &last_cycle_failed, bool quiet = false);
+    static void process_values(const InputReadingsEx &data_ex);
+    static void process_legacy_values(const InputReadings &data);
+    static void process_burst(const BurstReadings &burst);
+    static void filter_sample(int tuner_fine, int aknob, int bknob, int cknob, float dt);
+    static void store_analog();
 
   public:
     static void init();
     static void exit();
     static void get_values(int &tuner, int &aknob, int &bknob, int &cknob, int &swtch);
+    static int get_tuner_fine();
+    // Smoothed speed of the tuner in fine units per second
+    static int get_tuner_velocity();
+    static int get_cknob_level();
+    static bool get_switch_on();
     static void set_light(bool on);
+    // Light levels are 0 to 255, perceptually even; MCU runs the fade or breathing
+    static void fade_light(int level, int duration_msec);
+    static void breathe_light(int low, int high, int period_msec);
+    // Queues a vibration envelope; intensity is 0 to 255. Returns right away.
+    static void play_haptic(int intensity, int attack_msec, int sustain_msec, int decay_msec);
 };
 
-int tuner_val_to_freq(int val);
-int freq_to_tuner_val(int freq);
-
 #endif
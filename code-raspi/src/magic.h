@@ -10,6 +10,60 @@
 #define SLAVE_ADDRESS       0x50
 #define HWCTRL_CYCLE_MSEC   50
 
+// MCU's attention line; with it, the MCU is read when an input changes, at most every
+// ATTN_MIN_INTERVAL_MSEC, and at least every ATTN_TIMEOUT_MSEC. Opt-in: set the line that's
+// wired to the MCU's attention pin, or -1 to poll every HWCTRL_CYCLE_MSEC. Even when set,
+// it's only used if the MCU's hello reply has CAP_ATTENTION.
+#define ATTN_GPIO_CHIP          "/dev/gpiochip0"
+#define ATTN_GPIO_LINE          -1
+#define ATTN_MIN_INTERVAL_MSEC  10
+#define ATTN_TIMEOUT_MSEC       1000
+#define NEGOTIATE_ATTEMPTS  3
+// MCU that booted late gets asked again this often while it doesn't answer hello; one that
+// answered is asked again after this many failed reads in a row, in case it reset
+#define NEGOTIATE_RETRY_MSEC        2000
+#define NEGOTIATE_AFTER_FAILURES    5
+
+// One-Euro filter parameters per input channel: min cutoff (Hz), beta, derivative cutoff (Hz)
+#define FILTER_TUNER        1.0f, 0.01f, 1.0f
+#define FILTER_KNOB         1.0f, 0.005f, 1.0f
+
+// Noisy knob C is quantized to this many levels
+#define CKNOB_LEVELS        8
+#define CKNOB_HYSTERESIS    0.25f
+#define ADC_MAX             1023
+
+// Light fades when the knob switch turns it on or off (msec)
+#define LIGHT_FADE_IN_MSEC  300
+#define LIGHT_FADE_OUT_MSEC 800
+
+// Vibration when knob C clicks into a new level: intensity, attack, sustain, decay (msec)
+#define HAPTIC_DETENT       160, 4, 12, 30
+
+// Knob switch counts as on while its discharge is faster than this many MCU clock ticks
+#define SWITCH_THRESHOLD_TICKS  240
+// Legacy firmware reports steps of a polling loop instead of ticks
+#define SWITCH_LEGACY_TICKS_PER_STEP    30
+// MCU also reports tuner oversampled to 2 extra bits
+#define TUNER_FINE_SCALE    4
+
+// Frequencies are in units of 10 kHz: 9800 is 98.00 MHz
+#define FREQ_MIN            8800
+#define FREQ_MAX            10800
+#define TUNER_CALIB_FILE    "tuner-calibration.txt"
+
+// Default half-widths around a station's frequency where the signal locks,
+// and where the station's info overlay shows on top of static
+#define STATION_LOCK_WIDTH      8
+#define STATION_OVERLAY_WIDTH   30
+
+// Ghost of nearest station in static: level (of 256) at overlay edge, fading out over range
+#define GHOST_MAX_LEVEL         48
+#define GHOST_RANGE             100
+
+// Distinct strings whose text layouts are kept; more than this in use means churn
+#define TEXT_CACHE_ENTRIES      64
+
 // clang-format on
 
 #endif
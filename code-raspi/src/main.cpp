@@ -5,12 +5,33 @@
 
 // Global
 #include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [mode]\n", prog);
+    fprintf(stderr, "  calibrate               show live readings (default)\n");
+    fprintf(stderr, "  record-tuner [file]     record tuner calibration points\n");
+    fprintf(stderr, "  bench [name]            run all or one benchmark\n");
+}
 
 int main(int argc, char *argv[])
 {
     try
     {
-        calibrate_readings();
+        const char *mode = argc > 1 ? argv[1] : "calibrate";
+        if (strcmp(mode, "calibrate") == 0)
+            calibrate_readings();
+        else if (strcmp(mode, "record-tuner") == 0)
+            record_tuner_calibration(argc > 2 ? argv[2] : nullptr);
+        else if (strcmp(mode, "bench") == 0)
+            run_benchmarks(argc > 2 ? argv[2] : nullptr);
+        else
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
         return 0;
     }
     catch (const igr_exception &e)
@@ -3,5 +3,7 @@
 
 int main(int argc, char *argv[]);
 void calibrate_readings();
+void record_tuner_calibration(const char *path);
+void run_benchmarks(const char *which);
 
 #endif
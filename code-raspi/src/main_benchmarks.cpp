@@ -0,0 +1,570 @@
+#include "main.h"
+
+// Local dependencies
+#include "canvas_ity.h"
+#include "compositor.h"
+#include "error.h"
+#include "gfx_helpers.h"
+#include "magic.h"
+#include "protocol.h"
+#include "static_noise.h"
+#include "station_registry.h"
+#include "text_cache.h"
+
+// Global
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+static double get_time_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, int frames, double secs)
+{
+    double ms = secs * 1000 / frames;
+    printf("  %-32s %8.3f ms/frame %9.1f FPS\n", name, ms, 1000 / ms);
+}
+
+static void bench_static()
+{
+    const int frames = 500;
+    std::vector<uint16_t> frame(W * H);
+    std::vector<uint16_t> ghost(W * H, 0x7bef);
+
+    struct
+    {
+        const char *name;
+        bool correlation;
+        bool bars;
+        bool ghost;
+    } variants[] = {
+        {"plain noise", false, false, false},
+        {"line correlation + bars", true, true, false},
+        {"correlation + bars + ghost", true, true, true},
+    };
+
+    printf("Static noise, %d x %d RGB565\n", W, H);
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v)
+    {
+        StaticNoise noise;
+        noise.line_correlation = variants[v].correlation;
+        noise.rolling_bars = variants[v].bars;
+        noise.set_ghost(variants[v].ghost ? &ghost[0] : nullptr, GHOST_MAX_LEVEL);
+        double t0 = get_time_sec();
+        for (int i = 0; i < frames; ++i)
+            noise.render(&frame[0]);
+        report(variants[v].name, frames, get_time_sec() - t0);
+    }
+}
+
+static void bench_compose()
+{
+    const int frames = 500;
+    std::vector<uint16_t> a565(W * H, 0x1234), b565(W * H, 0xfedc);
+    std::vector<uint8_t> a8(W * H * 4, 0x20), b8(W * H * 4, 0xe0);
+    Compositor comp;
+    const uint16_t *res565 = nullptr;
+    const uint8_t *res8 = nullptr;
+    int mixes[] = {0, mix_one / 2, mix_one};
+    char name[64];
+
+    printf("Compositor, %d x %d\n", W, H);
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); ++m)
+    {
+        double t0 = get_time_sec();
+        for (int i = 0; i < frames; ++i)
+            res565 = comp.compose(&a565[0], &b565[0], mixes[m]);
+        snprintf(name, sizeof(name), "RGB565, mix %d", mixes[m]);
+        report(name, frames, get_time_sec() - t0);
+    }
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); ++m)
+    {
+        double t0 = get_time_sec();
+        for (int i = 0; i < frames; ++i)
+            res8 = comp.compose(&a8[0], &b8[0], mixes[m]);
+        snprintf(name, sizeof(name), "RGBA8, mix %d", mixes[m]);
+        report(name, frames, get_time_sec() - t0);
+    }
+    if (res565 == nullptr || res8 == nullptr) printf("No output\n");
+}
+
+static void bench_text()
+{
+    size_t font_size;
+    uint8_t *font = load_canvas_font(&font_size);
+    if (font == nullptr)
+        throwf("Failed to load font");
+    canvas_ity::canvas ctx(W, H);
+    ctx.set_font(font, (int)font_size, 64);
+
+    const char *texts[] = {
+        "Tuner  1023",
+        "Freq 101.35  +12",
+        "Zw\xc3\xb6lf Boxk\xc3\xa4mpfer jagen Viktor quer \xc3\xbc""ber den gro\xc3\x9f""en Sylter Deich",
+        "\xe2\x80\x9cQuoted\xe2\x80\x9d \xe2\x80\x93 dash \xe2\x80\xa6 \xe2\x82\xac 42 \xe2\x86\x92 \xe2\x98\x85",
+    };
+    const char *names[] = {"ASCII digits", "ASCII mixed", "Latin-1", "Punctuation and symbols"};
+
+    printf("Text, glyphs resolved by measure_text\n");
+    for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t)
+    {
+        // Count codepoints: every byte that doesn't continue a UTF-8 sequence
+        int glyphs = 0;
+        for (const char *p = texts[t]; *p; ++p)
+            if ((*p & 0xc0) != 0x80) ++glyphs;
+        const int reps = 200000;
+        float sum = 0;
+        double t0 = get_time_sec();
+        for (int i = 0; i < reps; ++i)
+            sum += ctx.measure_text(texts[t]);
+        double secs = get_time_sec() - t0;
+        printf("  %-32s %8.2f M glyphs/s (width %.1f)\n", names[t], glyphs * (double)reps / secs * 1e-6, sum / reps);
+    }
+
+    const int frames = 200;
+    double t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+    {
+        ctx.clear();
+        for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t)
+            ctx.fill_text(texts[t], 20, 100 + 64 * t);
+    }
+    report("fill_text, all lines", frames, get_time_sec() - t0);
+
+    // Same screen through cached layouts: measures layout reuse, rasterization is unchanged
+    TextLayoutCache cache(TEXT_CACHE_ENTRIES);
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+    {
+        ctx.clear();
+        for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t)
+            ctx.fill_glyphs(cache.get(ctx, font, texts[t]), 20, 100 + 64 * t);
+    }
+    report("fill_glyphs, cached layouts", frames, get_time_sec() - t0);
+
+    free(font);
+}
+
+static void bench_image()
+{
+    const int frames = 20;
+    canvas_ity::canvas ctx(W, H);
+    std::vector<uint8_t> in(W * H * 4), out(W * H * 4);
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+        {
+            uint8_t *p = &in[(y * W + x) * 4];
+            p[0] = x * 255 / (W - 1);
+            p[1] = y * 255 / (H - 1);
+            p[2] = (x + y) & 0xff;
+            p[3] = 255;
+        }
+
+    printf("Image data, %d x %d RGBA8\n", W, H);
+    double t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        ctx.put_image_data(&in[0], W, H, W * 4, 0, 0);
+    report("put_image_data", frames, get_time_sec() - t0);
+
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        ctx.get_image_data(&out[0], W, H, W * 4, 0, 0);
+    report("get_image_data", frames, get_time_sec() - t0);
+
+    // Dithering may round either way, but a round trip must not drift further
+    int max_error = 0;
+    for (size_t i = 0; i < in.size(); ++i)
+        max_error = std::max(max_error, abs((int)in[i] - (int)out[i]));
+    printf("  %-32s %8d\n", "round trip max error", max_error);
+
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        ctx.set_pattern(canvas_ity::fill_style, &in[0], W, H, W * 4, canvas_ity::repeat);
+    report("set_pattern", frames, get_time_sec() - t0);
+
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        ctx.draw_image(&in[0], W, H, W * 4, 0, 0, W, H);
+    report("draw_image 1:1", frames, get_time_sec() - t0);
+
+    const canvas_ity::filter_style filters[] = {canvas_ity::nearest, canvas_ity::bilinear, canvas_ity::bicubic};
+    const char *filter_names[] = {"draw_image 2x, nearest", "draw_image 2x, bilinear", "draw_image 2x, bicubic"};
+    for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+    {
+        ctx.image_filter = filters[f];
+        t0 = get_time_sec();
+        for (int i = 0; i < frames; ++i)
+            ctx.draw_image(&in[0], W / 2, H / 2, W * 4, 0, 0, W, H);
+        report(filter_names[f], frames, get_time_sec() - t0);
+    }
+}
+
+// Static part of a station screen: gradient, rings and lines of text
+static void draw_background(canvas_ity::canvas &ctx)
+{
+    ctx.set_linear_gradient(canvas_ity::fill_style, 0, 0, W, H);
+    ctx.add_color_stop(canvas_ity::fill_style, 0, 0.1f, 0.1f, 0.3f, 1);
+    ctx.add_color_stop(canvas_ity::fill_style, 1, 0.6f, 0.3f, 0.1f, 1);
+    ctx.fill_rectangle(0, 0, W, H);
+    ctx.set_line_width(4);
+    ctx.set_color(canvas_ity::stroke_style, 0.9f, 0.8f, 0.5f, 0.6f);
+    for (int i = 0; i < 8; ++i)
+    {
+        ctx.begin_path();
+        ctx.arc(W / 2, H / 2, 30.0f + 30 * i, 0, 6.2832f);
+        ctx.stroke();
+    }
+    ctx.set_color(canvas_ity::fill_style, 0.9f, 0.9f, 0.9f, 1);
+    for (int i = 0; i < 8; ++i)
+        ctx.fill_text("Sonic Youth - Teen Age Riot", 40, 60.0f + 64 * i);
+}
+
+static void bench_layer()
+{
+    const int frames = 20;
+    size_t font_size;
+    uint8_t *font = load_canvas_font(&font_size);
+    if (font == nullptr)
+        throwf("Failed to load font");
+    canvas_ity::canvas ctx(W, H), layer(W, H);
+    ctx.set_font(font, (int)font_size, 48);
+    layer.set_font(font, (int)font_size, 48);
+
+    printf("Static background plus a small animated foreground, %d x %d\n", W, H);
+    double t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+    {
+        draw_background(ctx);
+        ctx.set_color(canvas_ity::fill_style, 1, 0, 0, 1);
+        ctx.fill_rectangle(i * 10, 500, 40, 40);
+    }
+    report("redraw everything", frames, get_time_sec() - t0);
+
+    t0 = get_time_sec();
+    draw_background(layer);
+    for (int i = 0; i < frames; ++i)
+    {
+        ctx.draw_layer(layer, 0, 0);
+        ctx.set_color(canvas_ity::fill_style, 1, 0, 0, 1);
+        ctx.fill_rectangle(i * 10, 500, 40, 40);
+    }
+    report("background layer", frames, get_time_sec() - t0);
+    free(font);
+}
+
+static void bench_cull()
+{
+    const int frames = 20;
+    const int shapes = 500;
+    canvas_ity::canvas ctx(W, H);
+    ctx.set_color(canvas_ity::fill_style, 0.2f, 0.6f, 1, 1);
+
+    printf("%d circles per frame, %d x %d\n", shapes, W, H);
+    double t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        for (int j = 0; j < shapes; ++j)
+        {
+            ctx.begin_path();
+            ctx.arc(20 + (j * 37) % (W - 40), 20 + (j * 23) % (H - 40), 12, 0, 6.2832f);
+            ctx.fill();
+        }
+    report("onscreen", frames, get_time_sec() - t0);
+
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        for (int j = 0; j < shapes; ++j)
+        {
+            ctx.begin_path();
+            ctx.arc(-100 - (j * 37) % W, 20 + (j * 23) % (H - 40), 12, 0, 6.2832f);
+            ctx.fill();
+        }
+    report("offscreen", frames, get_time_sec() - t0);
+
+    // Only the top left corner is visible; every circle lies outside it
+    ctx.save();
+    ctx.begin_path();
+    ctx.rectangle(0, 0, W / 4, H / 4);
+    ctx.clip();
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        for (int j = 0; j < shapes; ++j)
+        {
+            ctx.begin_path();
+            ctx.arc(W / 2 + (j * 37) % (W / 2 - 20), H / 2 + (j * 23) % (H / 2 - 20), 12, 0, 6.2832f);
+            ctx.fill();
+        }
+    report("outside clip", frames, get_time_sec() - t0);
+    ctx.restore();
+}
+
+static void draw_blocks(canvas_ity::canvas &ctx, int frame)
+{
+    for (int j = 0; j < 200; ++j)
+    {
+        float x = (float)((j * 37 + frame * 3) % W);
+        float y = (float)((j * 23) % H);
+        ctx.set_color(canvas_ity::fill_style, (j % 3) * 0.5f, (j % 5) * 0.25f, 1, 1);
+        if (j & 1)
+            ctx.fill_rectangle(x - 20.5f, y - 12.5f, 41, 25);
+        else
+        {
+            ctx.begin_path();
+            ctx.arc(x, y, 24, 0, 6.2832f);
+            ctx.fill();
+        }
+    }
+}
+
+static void bench_aliasing()
+{
+    const int frames = 20;
+    canvas_ity::canvas ctx(W, H);
+
+    printf("200 opaque rectangles and circles per frame, %d x %d\n", W, H);
+    double t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        draw_blocks(ctx, i);
+    report("antialiased", frames, get_time_sec() - t0);
+
+    ctx.antialiasing = false;
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        draw_blocks(ctx, i);
+    report("aliased", frames, get_time_sec() - t0);
+}
+
+static void draw_coverage_scene(canvas_ity::canvas &ctx)
+{
+    ctx.clear_rectangle(0, 0, W, H);
+    ctx.set_color(canvas_ity::fill_style, 1, 1, 1, 1);
+    ctx.set_color(canvas_ity::stroke_style, 1, 1, 1, 1);
+    for (int j = 0; j < 300; ++j)
+    {
+        ctx.begin_path();
+        ctx.arc((float)((j * 53) % W), (float)((j * 31) % H), (float)(3 + j % 40), 0, 6.2832f);
+        ctx.fill();
+    }
+    ctx.save();
+    ctx.translate(W / 2, H / 2);
+    ctx.rotate(0.3f);
+    ctx.fill_rectangle(-100.3f, -50.7f, 200.1f, 101.9f);
+    ctx.restore();
+    ctx.set_line_width(1.3f);
+    for (int j = 0; j < 100; ++j)
+    {
+        ctx.begin_path();
+        ctx.move_to(j * 7.1f, 0);
+        ctx.line_to(W - j * 3.3f, H);
+        ctx.stroke();
+    }
+    ctx.fill_text("Fixed-point coverage 0123456789", 20, H - 40);
+}
+
+static void bench_fixed_point()
+{
+    const int frames = 10;
+    // Snapping to 1/64 pixel moves an edge's coverage by about 1/64; allow for a few edges per pixel
+    const int max_alpha_error = 12;
+    size_t font_size;
+    uint8_t *font = load_canvas_font(&font_size);
+    if (font == nullptr)
+        throwf("Failed to load font");
+    canvas_ity::canvas ctx(W, H), fixed(W, H);
+    ctx.set_font(font, (int)font_size, 48);
+    fixed.set_font(font, (int)font_size, 48);
+    fixed.fixed_point_coverage = true;
+
+    printf("Circles, a rotated rectangle, thin strokes and text, %d x %d\n", W, H);
+    double t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        draw_coverage_scene(ctx);
+    report("floating-point coverage", frames, get_time_sec() - t0);
+
+    t0 = get_time_sec();
+    for (int i = 0; i < frames; ++i)
+        draw_coverage_scene(fixed);
+    report("fixed-point coverage", frames, get_time_sec() - t0);
+
+    // Coverage of white drawn onto transparent black ends up in alpha, which isn't gamma encoded
+    std::vector<uint8_t> expected(W * H * 4), actual(W * H * 4);
+    ctx.get_image_data(expected.data(), W, H, W * 4, 0, 0);
+    fixed.get_image_data(actual.data(), W, H, W * 4, 0, 0);
+    int worst = 0;
+    long total = 0;
+    for (size_t i = 3; i < expected.size(); i += 4)
+    {
+        int error = abs(expected[i] - actual[i]);
+        worst = std::max(worst, error);
+        total += error;
+    }
+    printf("  alpha error: max %d/255, mean %.4f/255\n", worst, (double)total / (W * H));
+    free(font);
+    if (worst > max_alpha_error)
+        throwf("Fixed-point coverage is off by %d/255, more than %d/255", worst, max_alpha_error);
+}
+
+// Passes a command through the MCU's receive path: split as one write, then framed like its main loop
+template <typename T>
+static T round_trip_command(uint8_t cmd, const T &args)
+{
+    uint8_t write[1 + sizeof(T)];
+    write[0] = cmd;
+    memcpy(write + 1, &args, sizeof(T));
+    uint8_t queue[2 * MAX_COMMAND_SIZE];
+    uint8_t reply = CMD_READINGS_EX;
+    uint8_t len = splitWrite(write, sizeof(write), queue, sizeof(queue), reply);
+    if (reply != CMD_READINGS_EX)
+        throwf("Arguments of command 0x%02x selected reply 0x%02x", cmd, reply);
+    if (len != sizeof(write) || queue[0] != cmd || commandLength(queue[0]) != len)
+        throwf("Command 0x%02x arrived as %d bytes starting with 0x%02x", cmd, len, queue[0]);
+    T res;
+    memcpy(&res, queue + 1, sizeof(T));
+    return res;
+}
+
+static void bench_protocol()
+{
+    printf("Commands through the MCU's receive path\n");
+    HapticEnvelope detent = {HAPTIC_DETENT};
+    HapticEnvelope env = round_trip_command(CMD_HAPTIC, detent);
+    if (env.intensity != detent.intensity || env.attack != detent.attack || env.sustain != detent.sustain ||
+        env.decay != detent.decay)
+        throwf("Haptic envelope arrived as %d, %d, %d, %d", env.intensity, env.attack, env.sustain, env.decay);
+    printf("  haptic %d, %d, %d, %d: ok\n", env.intensity, env.attack, env.sustain, env.decay);
+
+    // Level 0 and the high bytes of 300 and 800 ms (0x01, 0x03) used to be taken as reply selections
+    const LightFade fades[] = {{0, LIGHT_FADE_OUT_MSEC}, {255, LIGHT_FADE_IN_MSEC}, {0, 0}, {3, 0x0f0f}};
+    for (size_t i = 0; i < sizeof(fades) / sizeof(fades[0]); ++i)
+    {
+        LightFade fade = round_trip_command(CMD_LIGHT_FADE, fades[i]);
+        if (fade.level != fades[i].level || fade.duration != fades[i].duration)
+            throwf("Light fade to %d over %d ms arrived as %d over %d ms", fades[i].level, fades[i].duration,
+                   fade.level, fade.duration);
+        printf("  light fade to %d over %d ms: ok\n", fade.level, fade.duration);
+    }
+    LightBreathe low = {0, 8, 0x0100};
+    LightBreathe breathe = round_trip_command(CMD_LIGHT_BREATHE, low);
+    if (breathe.low != low.low || breathe.high != low.high || breathe.period != low.period)
+        throwf("Light breathing %d to %d over %d ms arrived as %d to %d over %d ms", low.low, low.high, low.period,
+               breathe.low, breathe.high, breathe.period);
+    printf("  light breathing %d to %d over %d ms: ok\n", breathe.low, breathe.high, breathe.period);
+
+    // Reply selection still works, and a command cut short is dropped whole
+    uint8_t queue[2 * MAX_COMMAND_SIZE];
+    uint8_t reply = CMD_READINGS_EX;
+    uint8_t select[] = {CMD_BURST};
+    if (splitWrite(select, sizeof(select), queue, sizeof(queue), reply) != 0 || reply != CMD_BURST)
+        throwf("Reply selection failed: 0x%02x", reply);
+    uint8_t cut[] = {CMD_HAPTIC, 160, 4};
+    if (splitWrite(cut, sizeof(cut), queue, sizeof(queue), reply) != 0 || reply != CMD_BURST)
+        throwf("Truncated command was queued");
+    printf("  reply selection and truncated command: ok\n");
+}
+
+static void bench_stations()
+{
+    // Neighbors with unequal lock bands: A owns 8970..9030, B owns 9035..9045
+    StationRegistry registry;
+    Station a;
+    a.freq = 9000;
+    a.lock_width = 30;
+    a.overlay_width = 60;
+    a.title = "A";
+    Station b;
+    b.freq = 9040;
+    b.lock_width = 5;
+    b.overlay_width = 20;
+    b.title = "B";
+    registry.add(a);
+    registry.add(b);
+
+    struct
+    {
+        int freq;
+        int station_freq;
+        TuneState state;
+        int mix;
+        int ghost;
+    } expected[] = {
+        {9025, 9000, tune_on, mix_one, GHOST_MAX_LEVEL},
+        {9030, 9000, tune_on, mix_one, GHOST_MAX_LEVEL},
+        {9032, 9000, tune_near, -1, GHOST_MAX_LEVEL},
+        {9033, 9040, tune_near, -1, GHOST_MAX_LEVEL},
+        {9035, 9040, tune_on, mix_one, GHOST_MAX_LEVEL},
+        {8900, 9000, tune_static, 0, GHOST_MAX_LEVEL * (GHOST_RANGE - 40) / GHOST_RANGE},
+        {9200, 9040, tune_static, 0, 0},
+    };
+    printf("Station lookup with unequal lock widths\n");
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+    {
+        TuneResult tune = registry.tune(expected[i].freq);
+        int mix = Compositor::mix_for(tune);
+        int ghost = StaticNoise::ghost_level_for(tune);
+        // Near a station, the mix is somewhere strictly between static and the station
+        bool mix_ok = expected[i].mix < 0 ? mix > 0 && mix < mix_one : mix == expected[i].mix;
+        if (tune.station == nullptr || tune.station->freq != expected[i].station_freq ||
+            tune.state != expected[i].state || !mix_ok || ghost != expected[i].ghost)
+            throwf("Tuning to %d gave station %d, state %d, mix %d, ghost %d", expected[i].freq,
+                   tune.station ? tune.station->freq : -1, tune.state, mix, ghost);
+        printf("  %d: station %d, state %d, mix %3d, ghost %2d: ok\n", expected[i].freq, tune.station->freq,
+               tune.state, mix, ghost);
+    }
+
+    // Full band of stations with alternating widths
+    StationRegistry band;
+    for (int freq = FREQ_MIN; freq + 40 <= FREQ_MAX; freq += 40)
+    {
+        Station st;
+        st.freq = freq;
+        st.lock_width = (freq / 40) % 2 ? 4 : 12;
+        st.overlay_width = st.lock_width + 10;
+        band.add(st);
+    }
+    const int reps = 2000000;
+    long sum = 0;
+    double t0 = get_time_sec();
+    for (int i = 0; i < reps; ++i)
+        sum += Compositor::mix_for(band.tune(FREQ_MIN + i % (FREQ_MAX - FREQ_MIN)));
+    double secs = get_time_sec() - t0;
+    printf("  %-32s %8.1f ns/lookup (%zu stations, mix sum %ld)\n", "tune + mix_for", secs / reps * 1e9,
+           band.get_stations().size(), sum);
+}
+
+static const struct
+{
+    const char *name;
+    void (*func)();
+} benchmarks[] = {
+    {"static", bench_static},
+    {"compose", bench_compose},
+    {"text", bench_text},
+    {"image", bench_image},
+    {"layer", bench_layer},
+    {"cull", bench_cull},
+    {"aliasing", bench_aliasing},
+    {"fixed", bench_fixed_point},
+    {"protocol", bench_protocol},
+    {"stations", bench_stations},
+};
+
+void run_benchmarks(const char *which)
+{
+    bool found = false;
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+    {
+        if (which != nullptr && strcmp(which, benchmarks[i].name) != 0) continue;
+        found = true;
+        benchmarks[i].func();
+    }
+    if (!found)
+        printf("Unknown benchmark: %s\n", which);
+}
@@ -6,6 +6,7 @@
 #include "gfx_helpers.h"
 #include "hardware_controller.h"
 #include "magic.h"
+#include "tuner_calibration.h"
 
 // Global
 #include <algorithm>
@@ -33,13 +34,12 @@ static size_t font_data_size;
 
 static uint32_t loop_count = 0;
 static bool light_on = false;
-static const int rbsz = 4;
-static int rbuf[rbsz] = {0};
-static int rpos = 0;
+static int last_clevel = -1;
 
 void calibrate_readings()
 {
     HardwareController::init();
+    TunerCalibration::init();
 
     canvas_ity::canvas ctx(W, H);
     float *image = new float[H * W * 4];
@@ -59,26 +59,21 @@ void calibrate_readings()
 
         if (loop_count > 10)
         {
-            if (swtch < 4 && !light_on)
+            bool switch_on = HardwareController::get_switch_on();
+            if (switch_on != light_on)
             {
-                HardwareController::set_light(true);
-                light_on = true;
-            }
-            else if (swtch > 12 && light_on)
-            {
-                HardwareController::set_light(false);
-                light_on = false;
+                HardwareController::fade_light(switch_on ? 255 : 0, switch_on ? LIGHT_FADE_IN_MSEC : LIGHT_FADE_OUT_MSEC);
+                light_on = switch_on;
             }
         }
 
-        rbuf[rpos] = tuner;
-        rpos = (rpos + 1) % rbsz;
-        int sum = 0;
-        for (int i = 0; i < rbsz; ++i)
-            sum += rbuf[i];
-        // int avg = (sum + rbsz / 2) / rbsz;
-
-        int freq = tuner_val_to_freq(tuner);
+        int clevel = HardwareController::get_cknob_level();
+        if (clevel != last_clevel)
+        {
+            if (last_clevel != -1) HardwareController::play_haptic(HAPTIC_DETENT);
+            last_clevel = clevel;
+        }
+        int freq = tuner_fine_to_freq(HardwareController::get_tuner_fine());
 
         usleep(100000);
 
@@ -96,14 +91,14 @@ void calibrate_readings()
         ctx.set_color(canvas_ity::fill_style, 0.8, 0.8, 0.8, 1);
         sprintf(buf, "Tuner %5d", tuner);
         ctx.fill_text(buf, 100, 100);
-        sprintf(buf, "Freq  %5d", freq);
+        sprintf(buf, "Freq %6.2f %+5d", freq / 100.0, HardwareController::get_tuner_velocity());
         ctx.fill_text(buf, 100, 164);
 
         sprintf(buf, "    A  %4d", aknob);
         ctx.fill_text(buf, 100, 228);
         sprintf(buf, "    B  %4d", bknob);
         ctx.fill_text(buf, 100, 292);
-        sprintf(buf, "    C  %4d", cknob);
+        sprintf(buf, "    C  %4d %d", cknob, clevel);
         ctx.fill_text(buf, 100, 356);
         sprintf(buf, "   SW  %4d", swtch);
         ctx.fill_text(buf, 100, 428);
@@ -0,0 +1,110 @@
+#include "main.h"
+
+// Local dependencies
+#include "error.h"
+#include "hardware_controller.h"
+#include "tuner_calibration.h"
+
+// Global
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+static const int n_avg_samples = 10;
+
+static int read_steady_tuner()
+{
+    int sum = 0;
+    for (int i = 0; i < n_avg_samples; ++i)
+    {
+        int tuner, aknob, bknob, cknob, swtch;
+        HardwareController::get_values(tuner, aknob, bknob, cknob, swtch);
+        sum += tuner;
+        usleep(HWCTRL_CYCLE_MSEC * 1000);
+    }
+    return (sum + n_avg_samples / 2) / n_avg_samples;
+}
+
+static void print_help()
+{
+    printf("Turn the tuner to a known frequency, then type it in MHz and press Enter.\n");
+    printf("  <Enter>  show current reading\n");
+    printf("  u        remove last point\n");
+    printf("  q        save calibration and quit\n");
+}
+
+void record_tuner_calibration(const char *path)
+{
+    std::string out_path = path ? path : TunerCalibration::default_path();
+
+    HardwareController::init();
+    TunerCalibration::init();
+    print_help();
+
+    std::vector<CalibrationPoint> points;
+    char line[64];
+    while (true)
+    {
+        printf("> ");
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin)) break;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') ++p;
+
+        if (*p == 'q') break;
+        if (*p == 'u')
+        {
+            if (!points.empty()) points.pop_back();
+            printf("%d points\n", (int)points.size());
+            continue;
+        }
+
+        int tuner = read_steady_tuner();
+        if (*p == '\n' || *p == 0)
+        {
+            int freq = tuner_val_to_freq(tuner);
+            printf("Tuner %4d  =>  %d.%02d MHz with current calibration\n", tuner, freq / 100, freq % 100);
+            continue;
+        }
+
+        double mhz = atof(p);
+        if (mhz * 100 < FREQ_MIN || mhz * 100 > FREQ_MAX)
+        {
+            printf("Frequency must be between %d and %d MHz\n", FREQ_MIN / 100, FREQ_MAX / 100);
+            continue;
+        }
+
+        // Same reading recorded again replaces earlier point
+        std::vector<CalibrationPoint> new_points;
+        for (size_t i = 0; i < points.size(); ++i)
+            if (points[i].tuner_val != tuner) new_points.push_back(points[i]);
+        CalibrationPoint pt = {tuner, (int)(mhz * 100 + 0.5)};
+        new_points.push_back(pt);
+        if (new_points.size() >= 2)
+        {
+            try
+            {
+                TunerCalibration::set_points(new_points);
+            }
+            catch (const igr_exception &e)
+            {
+                printf("Point rejected: %s\n", e.what());
+                continue;
+            }
+        }
+        points.swap(new_points);
+        printf("Tuner %4d  =>  %.2f MHz recorded; %d points\n", tuner, mhz, (int)points.size());
+    }
+
+    HardwareController::exit();
+    if (points.size() < 2)
+    {
+        printf("\nFewer than 2 points recorded; calibration not saved.\n");
+        return;
+    }
+    TunerCalibration::set_points(points);
+    TunerCalibration::save(out_path.c_str());
+    printf("\nSaved %d points to %s\n", (int)points.size(), out_path.c_str());
+}
@@ -0,0 +1,82 @@
+#include "signal_filter.h"
+
+// Global
+#include <math.h>
+
+static float smoothing_factor(float cutoff, float dt)
+{
+    float tau = 1.0f / (2.0f * (float)M_PI * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+OneEuroFilter::OneEuroFilter(float min_cutoff, float beta, float d_cutoff)
+    : min_cutoff(min_cutoff)
+    , beta(beta)
+    , d_cutoff(d_cutoff)
+    , initialized(false)
+    , x_prev(0)
+    , dx_prev(0)
+{
+}
+
+void OneEuroFilter::reset()
+{
+    initialized = false;
+}
+
+float OneEuroFilter::filter(float x, float dt)
+{
+    if (!initialized || dt <= 0)
+    {
+        initialized = true;
+        x_prev = x;
+        dx_prev = 0;
+        return x;
+    }
+
+    // Smoothed derivative drives the cutoff of the value filter
+    float dx = (x - x_prev) / dt;
+    float a_d = smoothing_factor(d_cutoff, dt);
+    dx_prev = a_d * dx + (1.0f - a_d) * dx_prev;
+
+    float cutoff = min_cutoff + beta * fabsf(dx_prev);
+    float a = smoothing_factor(cutoff, dt);
+    x_prev = a * x + (1.0f - a) * x_prev;
+    return x_prev;
+}
+
+float OneEuroFilter::value() const
+{
+    return x_prev;
+}
+
+float OneEuroFilter::derivative() const
+{
+    return dx_prev;
+}
+
+HysteresisQuantizer::HysteresisQuantizer(int levels, float range_min, float range_max, float hysteresis)
+    : levels(levels)
+    , range_min(range_min)
+    , step((range_max - range_min) / levels)
+    , hysteresis(hysteresis)
+    , level(-1)
+{
+}
+
+int HysteresisQuantizer::quantize(float x)
+{
+    // Stay on current level while inside its band widened by the hysteresis margin
+    if (level >= 0)
+    {
+        float lo = range_min + (level - hysteresis) * step;
+        float hi = range_min + (level + 1 + hysteresis) * step;
+        if (x >= lo && x < hi) return level;
+    }
+
+    int new_level = (int)floorf((x - range_min) / step);
+    if (new_level < 0) new_level = 0;
+    if (new_level >= levels) new_level = levels - 1;
+    level = new_level;
+    return level;
+}
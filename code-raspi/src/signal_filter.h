@@ -0,0 +1,45 @@
+#ifndef SIGNAL_FILTER_H
+#define SIGNAL_FILTER_H
+
+// Adaptive low-pass filter: cutoff frequency rises with the speed of the signal,
+// so the value is steady at rest but follows fast movements with little lag.
+// See "1 Euro Filter: A Simple Speed-based Low-pass Filter for Noisy Input in
+// Interactive Systems" by Casiez, Roussel and Vogel (CHI 2012).
+class OneEuroFilter
+{
+  private:
+    float min_cutoff;
+    float beta;
+    float d_cutoff;
+    bool initialized;
+    float x_prev;
+    float dx_prev;
+
+  public:
+    OneEuroFilter(float min_cutoff, float beta, float d_cutoff);
+    void reset();
+    float filter(float x, float dt);
+    // Last output
+    float value() const;
+    // Smoothed rate of change of the input, per second
+    float derivative() const;
+};
+
+// Maps a continuous value onto a small number of discrete levels. The current
+// level only changes once the value is a fraction of a step past its boundary,
+// so noise around a threshold doesn't make the level flicker.
+class HysteresisQuantizer
+{
+  private:
+    int levels;
+    float range_min;
+    float step;
+    float hysteresis;
+    int level;
+
+  public:
+    HysteresisQuantizer(int levels, float range_min, float range_max, float hysteresis);
+    int quantize(float x);
+};
+
+#endif
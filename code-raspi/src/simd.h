@@ -0,0 +1,27 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+// GCC vector types: 128-bit ones map to NEON registers on the Pi, SSE on x86
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+typedef uint8_t u8x8 __attribute__((vector_size(8)));
+
+// Unaligned loads and stores
+template <typename V, typename T>
+static inline V vload(const T *src)
+{
+    V v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+template <typename V, typename T>
+static inline void vstore(T *dst, V v)
+{
+    memcpy(dst, &v, sizeof(v));
+}
+
+#endif
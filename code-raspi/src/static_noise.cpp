@@ -0,0 +1,104 @@
+#include "static_noise.h"
+
+// Global
+#include <math.h>
+#include <stdlib.h>
+
+static const int block = 8;
+static_assert(W % block == 0, "Frame width must be a multiple of the vector block");
+
+static const int bar_count = 2;
+static const int bar_depth = 96;
+static const float bar_speed = 0.0037f;
+
+StaticNoise::StaticNoise()
+    : bar_phase(0)
+    , ghost(nullptr)
+    , ghost_level(0)
+    , line_correlation(true)
+    , rolling_bars(true)
+{
+    u32x4 seed = {0x9e3779b9u, 0x7f4a7c15u, 0xf39cc060u, 0x5ced5a3bu};
+    state = seed;
+    update_row_gain();
+}
+
+void StaticNoise::set_ghost(const uint16_t *ghost_frame, int level)
+{
+    ghost = ghost_frame;
+    ghost_level = ghost_frame ? level : 0;
+}
+
+int StaticNoise::ghost_level_for(const TuneResult &tune)
+{
+    if (tune.station == nullptr) return 0;
+    int dist = abs(tune.detune) - tune.station->overlay_width;
+    if (dist <= 0) return GHOST_MAX_LEVEL;
+    if (dist >= GHOST_RANGE) return 0;
+    return GHOST_MAX_LEVEL * (GHOST_RANGE - dist) / GHOST_RANGE;
+}
+
+void StaticNoise::update_row_gain()
+{
+    for (int y = 0; y < H; ++y)
+    {
+        if (!rolling_bars)
+        {
+            row_gain[y] = 256;
+            continue;
+        }
+        float s = sinf(2 * (float)M_PI * (bar_count * (float)y / H - bar_phase));
+        row_gain[y] = (uint16_t)(256 - bar_depth * (1 + s) * 0.5f);
+    }
+    bar_phase += bar_speed;
+    if (bar_phase >= 1) bar_phase -= 1;
+}
+
+static inline u32x4 xorshift(u32x4 &x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+void StaticNoise::render(uint16_t *frame)
+{
+    update_row_gain();
+
+    const u16x8 dup_lo = {0, 0, 1, 1, 2, 2, 3, 3};
+    const uint16_t gl = (uint16_t)ghost_level;
+    const uint16_t nl = (uint16_t)(256 - gl);
+    u32x4 x = state;
+
+    for (int y = 0; y < H; ++y)
+    {
+        uint16_t *row = frame + y * W;
+        const uint16_t *ghost_row = ghost ? ghost + y * W : nullptr;
+        const uint16_t gain = row_gain[y];
+
+        for (int px = 0; px < W; px += block)
+        {
+            u16x8 rnd = (u16x8)xorshift(x);
+            if (line_correlation) rnd = __builtin_shuffle(rnd, dup_lo);
+
+            // 8-bit luma from the high byte of each random half, dimmed by the bar
+            u16x8 luma = ((rnd >> 8) * gain) >> 8;
+            u16x8 r = luma >> 3;
+            u16x8 g = luma >> 2;
+            u16x8 b = luma >> 3;
+
+            if (ghost_row)
+            {
+                u16x8 gp = vload<u16x8>(ghost_row + px);
+                r = (r * nl + (gp >> 11) * gl) >> 8;
+                g = (g * nl + ((gp >> 5) & 63) * gl) >> 8;
+                b = (b * nl + (gp & 31) * gl) >> 8;
+            }
+
+            u16x8 out = (r << 11) | (g << 5) | b;
+            vstore(row + px, out);
+        }
+    }
+    state = x;
+}
@@ -0,0 +1,40 @@
+#ifndef STATIC_NOISE_H
+#define STATIC_NOISE_H
+
+#include "magic.h"
+#include "simd.h"
+#include "station.h"
+#include "station_registry.h"
+
+#include <stdint.h>
+
+// TV static written straight into an RGB565 frame. Noise comes from lanes of
+// xorshift32 generators in GCC vector types, which compile to NEON on the Pi.
+class StaticNoise : public Renderer
+{
+  private:
+    u32x4 state;
+    uint16_t row_gain[H];
+    float bar_phase;
+    const uint16_t *ghost;
+    int ghost_level;
+
+  private:
+    void update_row_gain();
+
+  public:
+    // Stretch noise grains horizontally, like a CRT's smeared static
+    bool line_correlation;
+    // Dark bands slowly rolling down the screen
+    bool rolling_bars;
+
+  public:
+    StaticNoise();
+    // Mix a faint image of a station into the noise; level is 0 to 256
+    void set_ghost(const uint16_t *ghost_frame, int level);
+    virtual void render(uint16_t *frame);
+
+    static int ghost_level_for(const TuneResult &tune);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef STATION_H
+#define STATION_H
+
+#include "magic.h"
+
+#include <stdint.h>
+#include <string>
+
+// Draws a station's animation into a W x H RGB565 frame
+class Renderer
+{
+  public:
+    virtual ~Renderer() {}
+    virtual void render(uint16_t *frame) = 0;
+};
+
+struct Station
+{
+    // Center frequency, in 10 kHz units
+    int freq;
+    // Half-width of band around freq where the station is received cleanly
+    int lock_width;
+    // Half-width of band where the station shows through static with its info overlay
+    int overlay_width;
+    std::string author;
+    std::string title;
+    // Not owned by the station
+    Renderer *renderer;
+
+    Station()
+        : freq(0)
+        , lock_width(STATION_LOCK_WIDTH)
+        , overlay_width(STATION_OVERLAY_WIDTH)
+        , renderer(nullptr)
+    {
+    }
+};
+
+#endif
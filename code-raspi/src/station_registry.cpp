@@ -0,0 +1,70 @@
+#include "station_registry.h"
+
+// Local dependencies
+#include "error.h"
+
+// Global
+#include <algorithm>
+#include <stdlib.h>
+
+static bool operator<(const Station &a, const Station &b)
+{
+    return a.freq < b.freq;
+}
+
+// a is below b; their lock bands must not touch
+static void check_spacing(const Station &a, const Station &b)
+{
+    if (b.freq - a.freq <= a.lock_width + b.lock_width)
+        throwf("Stations '%s' and '%s' are too close: %d and %d",
+               a.title.c_str(), b.title.c_str(), a.freq, b.freq);
+}
+
+void StationRegistry::add(const Station &station)
+{
+    if (station.lock_width < 0 || station.overlay_width < station.lock_width)
+        throwf("Station '%s' has invalid lock/overlay widths: %d, %d",
+               station.title.c_str(), station.lock_width, station.overlay_width);
+
+    // Checked against its neighbors before inserting, so a rejected station leaves the registry as it was
+    std::vector<Station>::iterator pos = std::upper_bound(stations.begin(), stations.end(), station);
+    if (pos != stations.begin()) check_spacing(*(pos - 1), station);
+    if (pos != stations.end()) check_spacing(station, *pos);
+    stations.insert(pos, station);
+    build_index();
+}
+
+void StationRegistry::build_index()
+{
+    boundaries.clear();
+    for (size_t i = 0; i + 1 < stations.size(); ++i)
+    {
+        // First frequency that belongs to b: halfway across the gap between the lock bands,
+        // so each station keeps its whole lock band even when the widths differ
+        const Station &a = stations[i];
+        const Station &b = stations[i + 1];
+        int gap = (b.freq - b.lock_width) - (a.freq + a.lock_width);
+        boundaries.push_back(a.freq + a.lock_width + (gap + 1) / 2);
+    }
+}
+
+const std::vector<Station> &StationRegistry::get_stations() const
+{
+    return stations;
+}
+
+TuneResult StationRegistry::tune(int freq) const
+{
+    TuneResult res = {tune_static, nullptr, 0};
+    if (stations.empty()) return res;
+
+    size_t ix = std::upper_bound(boundaries.begin(), boundaries.end(), freq) - boundaries.begin();
+    const Station &st = stations[ix];
+    res.station = &st;
+    res.detune = freq - st.freq;
+
+    int dist = abs(res.detune);
+    if (dist <= st.lock_width) res.state = tune_on;
+    else if (dist <= st.overlay_width) res.state = tune_near;
+    return res;
+}
@@ -0,0 +1,42 @@
+#ifndef STATION_REGISTRY_H
+#define STATION_REGISTRY_H
+
+#include "station.h"
+
+#include <vector>
+
+enum TuneState
+{
+    tune_static,
+    tune_near,
+    tune_on,
+};
+
+struct TuneResult
+{
+    TuneState state;
+    // Nearest station, also when state is static; null if registry is empty
+    const Station *station;
+    // Current frequency minus station's frequency
+    int detune;
+};
+
+// Stations sorted by frequency, indexed by boundaries halfway between the lock bands of neighbors.
+// Each station owns the interval between the boundaries around it, so the
+// nearest station to a frequency is found with one binary search.
+class StationRegistry
+{
+  private:
+    std::vector<Station> stations;
+    std::vector<int> boundaries;
+
+  private:
+    void build_index();
+
+  public:
+    void add(const Station &station);
+    const std::vector<Station> &get_stations() const;
+    TuneResult tune(int freq) const;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#include "text_cache.h"
+
+TextLayoutCache::TextLayoutCache(size_t max_entries)
+    : max_entries(max_entries)
+{
+}
+
+const canvas_ity::text_layout &TextLayoutCache::get(canvas_ity::canvas &ctx, const void *font, const char *text)
+{
+    Key key(font, text);
+    std::map<Key, canvas_ity::text_layout>::iterator it = layouts.find(key);
+    if (it != layouts.end()) return it->second;
+
+    // Strings drawn every frame are few; anything past the limit is churn, so start over
+    if (layouts.size() >= max_entries) layouts.clear();
+    canvas_ity::text_layout &layout = layouts[key];
+    ctx.layout_text(text, layout);
+    return layout;
+}
+
+void TextLayoutCache::clear()
+{
+    layouts.clear();
+}
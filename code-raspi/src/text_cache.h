@@ -0,0 +1,29 @@
+#ifndef TEXT_CACHE_H
+#define TEXT_CACHE_H
+
+// Local dependencies
+#include "canvas_ity.h"
+
+// Global
+#include <map>
+#include <stddef.h>
+#include <string>
+
+// Layouts of strings that are drawn again and again, so they skip UTF-8 decoding and glyph lookup.
+// Layouts are in font units, so they're keyed by font data and string only: changing the size
+// with set_font() keeps them valid. The font is identified by the pointer that was passed to set_font().
+class TextLayoutCache
+{
+  private:
+    typedef std::pair<const void *, std::string> Key;
+    std::map<Key, canvas_ity::text_layout> layouts;
+    size_t max_entries;
+
+  public:
+    TextLayoutCache(size_t max_entries);
+    // Layout of text in ctx's current font; reference is valid until the next call
+    const canvas_ity::text_layout &get(canvas_ity::canvas &ctx, const void *font, const char *text);
+    void clear();
+};
+
+#endif
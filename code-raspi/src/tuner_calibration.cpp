@@ -0,0 +1,185 @@
+#include "tuner_calibration.h"
+
+// Local dependencies
+#include "error.h"
+#include "gfx_helpers.h"
+
+// Global
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int16_t TunerCalibration::val_to_freq_lut[n_vals];
+int16_t TunerCalibration::freq_to_val_lut[n_freqs];
+std::vector<CalibrationPoint> TunerCalibration::points;
+
+// Measured before there was a calibration file
+static const CalibrationPoint default_points[] = {
+    {144, 9000},
+    {473, 9800},
+    {703, 10200},
+};
+
+static bool operator<(const CalibrationPoint &a, const CalibrationPoint &b)
+{
+    return a.tuner_val < b.tuner_val;
+}
+
+void TunerCalibration::init()
+{
+    std::string path = default_path();
+    if (access(path.c_str(), R_OK) == 0)
+    {
+        load(path.c_str());
+        return;
+    }
+    size_t n_default = sizeof(default_points) / sizeof(default_points[0]);
+    set_points(std::vector<CalibrationPoint>(default_points, default_points + n_default));
+}
+
+std::string TunerCalibration::default_path()
+{
+    return get_bin_path(TUNER_CALIB_FILE);
+}
+
+void TunerCalibration::load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        throwf_errno("Failed to open tuner calibration '%s'", path);
+
+    std::vector<CalibrationPoint> new_points;
+    char line[256];
+    int line_num = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        ++line_num;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == 0) continue;
+        int val;
+        double mhz;
+        if (sscanf(p, "%d %lf", &val, &mhz) != 2)
+        {
+            fclose(f);
+            throwf("Invalid line %d in tuner calibration '%s'", line_num, path);
+        }
+        CalibrationPoint pt = {val, (int)round(mhz * 100)};
+        new_points.push_back(pt);
+    }
+    fclose(f);
+    set_points(new_points);
+}
+
+void TunerCalibration::save(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        throwf_errno("Failed to create tuner calibration '%s'", path);
+    fprintf(f, "# Tuner reading, frequency in MHz\n");
+    for (size_t i = 0; i < points.size(); ++i)
+        fprintf(f, "%d %.2f\n", points[i].tuner_val, points[i].freq / 100.0);
+    fclose(f);
+}
+
+void TunerCalibration::set_points(const std::vector<CalibrationPoint> &new_points)
+{
+    std::vector<CalibrationPoint> sorted(new_points);
+    std::sort(sorted.begin(), sorted.end());
+
+    if (sorted.size() < 2)
+        throwf("Tuner calibration needs at least 2 points, got %d", (int)sorted.size());
+
+    // Frequency must be strictly monotone in tuner value for the fit to be invertible
+    int dir = sorted[1].freq > sorted[0].freq ? 1 : -1;
+    for (size_t i = 1; i < sorted.size(); ++i)
+    {
+        int dx = sorted[i].tuner_val - sorted[i - 1].tuner_val;
+        int dy = sorted[i].freq - sorted[i - 1].freq;
+        if (dx == 0 || dy * dir <= 0)
+            throwf("Tuner calibration is not strictly monotone at tuner value %d", sorted[i].tuner_val);
+    }
+
+    points.swap(sorted);
+    build_luts();
+}
+
+const std::vector<CalibrationPoint> &TunerCalibration::get_points()
+{
+    return points;
+}
+
+void TunerCalibration::build_luts()
+{
+    // Monotone cubic Hermite tangents. See "Monotone Piecewise Cubic
+    // Interpolation" by Fritsch and Carlson (SIAM J. Numer. Anal., 1980).
+    size_t n = points.size();
+    std::vector<double> x(n), y(n), m(n), d(n - 1);
+    for (size_t i = 0; i < n; ++i)
+    {
+        x[i] = points[i].tuner_val;
+        y[i] = points[i].freq;
+    }
+    for (size_t i = 0; i + 1 < n; ++i)
+        d[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]);
+    m[0] = d[0];
+    m[n - 1] = d[n - 2];
+    for (size_t i = 1; i + 1 < n; ++i)
+        m[i] = d[i - 1] * d[i] <= 0 ? 0 : (d[i - 1] + d[i]) / 2;
+    for (size_t i = 0; i + 1 < n; ++i)
+    {
+        double a = m[i] / d[i];
+        double b = m[i + 1] / d[i];
+        double h = a * a + b * b;
+        if (h > 9)
+        {
+            double t = 3 / sqrt(h);
+            m[i] = t * a * d[i];
+            m[i + 1] = t * b * d[i];
+        }
+    }
+
+    // Forward LUT; linear extrapolation beyond the outermost points
+    size_t seg = 0;
+    for (int val = 0; val < n_vals; ++val)
+    {
+        double freq;
+        if (val <= x[0])
+            freq = y[0] + m[0] * (val - x[0]);
+        else if (val >= x[n - 1])
+            freq = y[n - 1] + m[n - 1] * (val - x[n - 1]);
+        else
+        {
+            while (val > x[seg + 1]) ++seg;
+            double h = x[seg + 1] - x[seg];
+            double t = (val - x[seg]) / h;
+            double t2 = t * t, t3 = t2 * t;
+            freq = (2 * t3 - 3 * t2 + 1) * y[seg] + (t3 - 2 * t2 + t) * h * m[seg] + (-2 * t3 + 3 * t2) * y[seg + 1] + (t3 - t2) * h * m[seg + 1];
+        }
+        freq = round(freq);
+        if (freq < FREQ_MIN) freq = FREQ_MIN;
+        if (freq > FREQ_MAX) freq = FREQ_MAX;
+        val_to_freq_lut[val] = (int16_t)freq;
+    }
+
+    // Inverse LUT: for every frequency, the tuner value whose forward lookup is closest.
+    // Forward LUT is monotone, so one sweep in order of rising frequency finds them all.
+    bool rising = points.back().freq > points.front().freq;
+    int step = rising ? 1 : -1;
+    int val = rising ? 0 : n_vals - 1;
+    for (int freq = FREQ_MIN; freq <= FREQ_MAX; ++freq)
+    {
+        while (val + step >= 0 && val + step < n_vals &&
+               abs(val_to_freq_lut[val + step] - freq) <= abs(val_to_freq_lut[val] - freq))
+        {
+            // Stay on the first value of a plateau at the target frequency
+            if (val_to_freq_lut[val] == freq) break;
+            val += step;
+        }
+        freq_to_val_lut[freq - FREQ_MIN] = (int16_t)val;
+    }
+}
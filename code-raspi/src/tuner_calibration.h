@@ -0,0 +1,82 @@
+#ifndef TUNER_CALIBRATION_H
+#define TUNER_CALIBRATION_H
+
+#include "magic.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct CalibrationPoint
+{
+    int tuner_val;
+    int freq;
+};
+
+// Maps raw tuner readings to frequencies through a monotone piecewise-cubic
+// fit of measured calibration points. The fit is baked into a forward LUT
+// over all ADC values, and an inverse LUT over the frequency band, so
+// lookups at runtime are a single array read.
+class TunerCalibration
+{
+  private:
+    static const int n_vals = ADC_MAX + 1;
+    static const int n_freqs = FREQ_MAX - FREQ_MIN + 1;
+    static int16_t val_to_freq_lut[n_vals];
+    static int16_t freq_to_val_lut[n_freqs];
+    static std::vector<CalibrationPoint> points;
+
+  private:
+    static void build_luts();
+
+  public:
+    static void init();
+    static void load(const char *path);
+    static void save(const char *path);
+    static void set_points(const std::vector<CalibrationPoint> &new_points);
+    static const std::vector<CalibrationPoint> &get_points();
+    static std::string default_path();
+
+    static inline int val_to_freq(int val)
+    {
+        if (val < 0) val = 0;
+        if (val > ADC_MAX) val = ADC_MAX;
+        return val_to_freq_lut[val];
+    }
+
+    // Fine value has TUNER_FINE_SCALE steps per plain reading; interpolates between LUT entries
+    static inline int fine_to_freq(int fine)
+    {
+        if (fine < 0) fine = 0;
+        if (fine > ADC_MAX * TUNER_FINE_SCALE) fine = ADC_MAX * TUNER_FINE_SCALE;
+        int val = fine / TUNER_FINE_SCALE;
+        int frac = fine % TUNER_FINE_SCALE;
+        if (frac == 0) return val_to_freq_lut[val];
+        int weighted = val_to_freq_lut[val] * (TUNER_FINE_SCALE - frac) + val_to_freq_lut[val + 1] * frac;
+        return (weighted + TUNER_FINE_SCALE / 2) / TUNER_FINE_SCALE;
+    }
+
+    static inline int freq_to_val(int freq)
+    {
+        if (freq < FREQ_MIN) freq = FREQ_MIN;
+        if (freq > FREQ_MAX) freq = FREQ_MAX;
+        return freq_to_val_lut[freq - FREQ_MIN];
+    }
+};
+
+inline int tuner_val_to_freq(int val)
+{
+    return TunerCalibration::val_to_freq(val);
+}
+
+inline int tuner_fine_to_freq(int fine)
+{
+    return TunerCalibration::fine_to_freq(fine);
+}
+
+inline int freq_to_tuner_val(int freq)
+{
+    return TunerCalibration::freq_to_val(freq);
+}
+
+#endif
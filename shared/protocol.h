@@ -0,0 +1,204 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// I2C protocol between MCU (slave) and Pi (master); included by both code-mcu and code-raspi.
+// The Pi writes one command byte, then its arguments if any; commands below 0x10 select what
+// the next read returns.
+// Apart from legacy 0x00, replies are frames: version byte, payload, CRC-8 of both.
+
+#include <stdint.h>
+
+// clang-format off
+
+#define PROTOCOL_VERSION    1
+
+// Reply selection
+#define CMD_READINGS        0x00    // InputReadings, unframed; understood by all firmware versions
+#define CMD_READINGS_EX     0x01    // Frame<InputReadingsEx>
+#define CMD_BURST           0x02    // Frame<BurstReadings>
+#define CMD_HELLO           0x03    // Frame<HelloReply>
+
+// Actions
+#define CMD_LIGHT_OFF       0x10
+#define CMD_LIGHT_ON        0x11
+#define CMD_LIGHT_FADE      0x12    // Followed by LightFade
+#define CMD_LIGHT_BREATHE   0x13    // Followed by LightBreathe
+#define CMD_ATTN_OFF        0x20
+#define CMD_ATTN_ON         0x21
+#define CMD_HAPTIC          0x30    // Followed by HapticEnvelope
+
+// Capability bits in HelloReply
+#define CAP_READINGS_EX     0x0001  // Sequence number, timestamp, fine tuner and switch ticks
+#define CAP_BURST           0x0002  // Recent samples history
+#define CAP_ATTENTION       0x0004  // Attention line on input change
+#define CAP_HAPTIC          0x0008  // Vibration envelopes
+#define CAP_LIGHT_FADE      0x0010  // Dimmable light with fades and breathing
+
+// Samples per channel in BurstReadings
+#define BURST_LENGTH        6
+
+// Size of the MCU's TWI buffer: no reply can be longer
+#define MAX_REPLY_SIZE      32
+// Longest command with its arguments; one write carries one command
+#define MAX_COMMAND_SIZE    8
+
+// clang-format on
+
+#pragma pack(push, 1)
+struct InputReadings
+{
+    uint16_t tuner;
+    uint16_t aKnob;
+    uint16_t bKnob;
+    uint16_t cKnob;
+    uint8_t swtch;
+};
+
+// Readings plus how fresh they are
+struct InputReadingsEx
+{
+    InputReadings readings;
+    // Incremented with every refreshed snapshot
+    uint16_t seq;
+    // Time of newest sample in microseconds, derived from sample count; wraps around
+    uint32_t sampleTime;
+    // Tuner with 2 more bits of resolution, from hardware oversampling
+    uint16_t tunerFine;
+    // Switch discharge time in MCU clock ticks
+    uint16_t swtchTicks;
+};
+
+// Oldest sample, then each following one as a delta from the previous decoded value.
+// Deltas saturate, so a fast jump is spread out.
+struct BurstChannel
+{
+    uint16_t first;
+    int8_t deltas[BURST_LENGTH - 1];
+};
+
+// Recent decimated samples of knob A, B, C and tuner (fine)
+struct BurstReadings
+{
+    // Counter of newest decimated sample; wraps around
+    uint16_t seq;
+    BurstChannel channels[4];
+};
+
+// What the firmware supports, and the timing of its samples
+struct HelloReply
+{
+    uint16_t capabilities;
+    // Time between samples in InputReadingsEx and in BurstReadings, in microseconds
+    uint16_t samplePeriod;
+    uint16_t burstPeriod;
+};
+
+// Vibration: ramp up to intensity, hold, ramp down; times in milliseconds.
+// Replaces the envelope that's playing.
+struct HapticEnvelope
+{
+    uint8_t intensity;
+    uint16_t attack;
+    uint16_t sustain;
+    uint16_t decay;
+};
+
+// Light: fade from current level to this one; levels are perceptual, MCU applies gamma
+struct LightFade
+{
+    uint8_t level;
+    uint16_t duration;
+};
+
+// Light: swing between two levels until the next light command
+struct LightBreathe
+{
+    uint8_t low;
+    uint8_t high;
+    uint16_t period;
+};
+
+template <typename T>
+struct Frame
+{
+    uint8_t version;
+    T payload;
+    uint8_t crc;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(InputReadings) == 9, "InputReadings is part of the legacy protocol");
+static_assert(sizeof(Frame<InputReadingsEx>) <= MAX_REPLY_SIZE, "Reply too long");
+static_assert(sizeof(Frame<BurstReadings>) <= MAX_REPLY_SIZE, "Reply too long");
+static_assert(sizeof(Frame<HelloReply>) <= MAX_REPLY_SIZE, "Reply too long");
+static_assert(1 + sizeof(HapticEnvelope) <= MAX_COMMAND_SIZE, "Command too long");
+static_assert(1 + sizeof(LightFade) <= MAX_COMMAND_SIZE, "Command too long");
+static_assert(1 + sizeof(LightBreathe) <= MAX_COMMAND_SIZE, "Command too long");
+
+// Length of a command including its arguments
+inline uint8_t commandLength(uint8_t cmd)
+{
+    if (cmd == CMD_HAPTIC) return 1 + sizeof(HapticEnvelope);
+    if (cmd == CMD_LIGHT_FADE) return 1 + sizeof(LightFade);
+    if (cmd == CMD_LIGHT_BREATHE) return 1 + sizeof(LightBreathe);
+    return 1;
+}
+
+// Splits the bytes of one write into a reply selection and whole commands. Only a byte where a
+// command starts can select a reply, so arguments may take any value, 0x00 to 0x0F included.
+// Commands are appended to out while they fit in room; one cut short by the end of the write
+// is dropped. Returns the number of bytes appended, and updates reply if the write selects one.
+inline uint8_t splitWrite(const uint8_t *in, uint8_t len, uint8_t *out, uint8_t room, uint8_t &reply)
+{
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < len;)
+    {
+        uint8_t cmd = in[i];
+        if (cmd < CMD_LIGHT_OFF)
+        {
+            reply = cmd;
+            ++i;
+            continue;
+        }
+        uint8_t cmdLen = commandLength(cmd);
+        if (i + cmdLen > len) break;
+        if (used + cmdLen <= room)
+        {
+            for (uint8_t j = 0; j < cmdLen; ++j)
+                out[used + j] = in[i + j];
+            used += cmdLen;
+        }
+        i += cmdLen;
+    }
+    return used;
+}
+
+// CRC-8 with polynomial 0x07, initial value 0
+inline uint8_t crc8(const void *data, uint8_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < len; ++i)
+    {
+        crc ^= p[i];
+        for (uint8_t bit = 0; bit < 8; ++bit)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Fills in version and CRC once the payload is complete
+template <typename T>
+inline void sealFrame(Frame<T> &frame)
+{
+    frame.version = PROTOCOL_VERSION;
+    frame.crc = crc8(&frame, sizeof(Frame<T>) - 1);
+}
+
+template <typename T>
+inline bool frameValid(const Frame<T> &frame)
+{
+    return frame.version == PROTOCOL_VERSION && frame.crc == crc8(&frame, sizeof(Frame<T>) - 1);
+}
+
+#endif